@@ -13,6 +13,28 @@
 #include <regex>
 #include <cmath>
 #include <stack>
+#include <limits>
+#include <cstring>
+#include <ostream>
+#include <istream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
 
 #ifndef IMGUICTE_ENABLE_SPIRV
 #define IMGUICTE_ENABLE_SPIRV 0
@@ -34,6 +56,112 @@
 
 namespace ImTextEdit {
 
+// documents larger than this are loaded on all cores
+static const size_t ParallelLoadThreshold = 8 * 1024 * 1024;
+
+// size of the buffer ForEachChunk() hands to its callback
+static const size_t TextChunkSize = 64 * 1024;
+
+// file view: every Nth line start is indexed, at most this many decoded lines are kept
+static const int FileViewIndexStep = 256;
+static const size_t FileViewCacheSize = 4096;
+
+// autocomplete: number of ranked suggestions listed
+static const size_t ACMaxSuggestions = 256;
+
+// file watch: polling interval and the default quiet time before a change is reloaded, in milliseconds
+static const int FileWatchPollInterval = 100;
+static const int FileWatchDelay = 200;
+
+// line diff: hunks of old lines [mOldStart, mOldEnd) replaced by new lines [mNewStart, mNewEnd)
+struct LineHunk {
+    int mOldStart, mOldEnd;
+    int mNewStart, mNewEnd;
+};
+
+// larger distances replace the whole differing middle at once
+static const int MaxDiffDistance = 2048;
+
+// Myers' O(ND) diff over the lines between the common prefix and suffix
+template<class Equal>
+static std::vector<LineHunk> DiffLines(int aOldCount, int aNewCount, Equal aEqual)
+{
+    std::vector<LineHunk> hunks;
+
+    int prefix = 0;
+    while (prefix < aOldCount && prefix < aNewCount && aEqual(prefix, prefix))
+        prefix++;
+    int suffix = 0;
+    while (suffix < aOldCount - prefix && suffix < aNewCount - prefix && aEqual(aOldCount - 1 - suffix, aNewCount - 1 - suffix))
+        suffix++;
+
+    int n = aOldCount - prefix - suffix;
+    int m = aNewCount - prefix - suffix;
+    if (n == 0 && m == 0)
+        return hunks;
+    if (n == 0 || m == 0) {
+        hunks.push_back({ prefix, prefix + n, prefix, prefix + m });
+        return hunks;
+    }
+
+    // forward pass, the furthest x of every diagonal k is kept per distance for the backtrack
+    int maxDistance = std::min(n + m, MaxDiffDistance);
+    std::vector<int> v(2 * maxDistance + 3, 0);
+    std::vector<std::vector<int>> trace;
+    int offset = maxDistance + 1;
+    int distance = -1;
+    for (int d = 0; d <= maxDistance && distance < 0; d++) {
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ? v[offset + k + 1] : v[offset + k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && aEqual(prefix + x, prefix + y)) {
+                x++;
+                y++;
+            }
+            v[offset + k] = x;
+            if (x >= n && y >= m) {
+                distance = d;
+                break;
+            }
+        }
+        trace.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+    }
+
+    if (distance < 0) {
+        hunks.push_back({ prefix, prefix + n, prefix, prefix + m });
+        return hunks;
+    }
+
+    // walk back to collect the matching lines
+    std::vector<std::pair<int, int>> matches;
+    int x = n, y = m;
+    for (int d = distance; d > 0; d--) {
+        auto& prev = trace[d - 1]; // diagonals -(d - 1) to d - 1 before step d
+        auto at = [&](int k) { return prev[k + d - 1]; };
+        int k = x - y;
+        int prevK = (k == -d || (k != d && at(k - 1) < at(k + 1))) ? k + 1 : k - 1;
+        int prevX = at(prevK);
+        int prevY = prevX - prevK;
+        while (x > prevX && y > prevY)
+            matches.emplace_back(--x, --y);
+        x = prevX;
+        y = prevY;
+    }
+    while (x > 0 && y > 0)
+        matches.emplace_back(--x, --y);
+
+    int oldPos = 0, newPos = 0;
+    for (auto it = matches.rbegin(); it != matches.rend(); ++it) {
+        if (it->first > oldPos || it->second > newPos)
+            hunks.push_back({ prefix + oldPos, prefix + it->first, prefix + newPos, prefix + it->second });
+        oldPos = it->first + 1;
+        newPos = it->second + 1;
+    }
+    if (oldPos < n || newPos < m)
+        hunks.push_back({ prefix + oldPos, prefix + n, prefix + newPos, prefix + m });
+    return hunks;
+}
+
 template<class InputIt1, class InputIt2, class BinaryPredicate>
 bool equals(InputIt1 first1, InputIt1 last1,
     InputIt2 first2, InputIt2 last2, BinaryPredicate p)
@@ -62,9 +190,44 @@ bool isOpeningBracket(char close, char actual)
     return (close == '}' && actual == '{') || (close == ']' && actual == '[') || (close == ')' && actual == '(');
 }
 
+TextEditor::Document::Document()
+    : mUndoIndex(0)
+    , mTextVersion(0)
+    , mLineOffsetsVersion(0)
+    , mFoldSorted(false)
+    , mColorRangeMin(0)
+    , mColorRangeMax(0)
+    , mCheckComments(true)
+    , mCommentScanFrom(0)
+    , mTailCommentLine(-1)
+    , mColorVersion(0)
+    , mSnapshotStale(true)
+{
+    mLines.push_back(Line());
+}
+
 TextEditor::TextEditor()
-    : mLineSpacing(1.0f)
-    , mUndoIndex(0)
+    : TextEditor(std::make_shared<Document>())
+{
+}
+
+TextEditor::TextEditor(std::shared_ptr<Document> aDocument)
+    : mDocument(aDocument)
+    , mSeenTextVersion(aDocument->mTextVersion)
+    , mLineSpacing(1.0f)
+    , mLines(aDocument->mLines)
+    , mUndoBuffer(aDocument->mUndoBuffer)
+    , mUndoIndex(aDocument->mUndoIndex)
+    , mEditDepth(0)
+    , mEditContentChanged(false)
+    , mEditLineMin(0)
+    , mEditLineMax(0)
+    , mFoldBegin(aDocument->mFoldBegin)
+    , mFoldEnd(aDocument->mFoldEnd)
+    , mFoldConnection(aDocument->mFoldConnection)
+    , mFold(aDocument->mFold)
+    , mFoldSorted(aDocument->mFoldSorted)
+    , mChangedLines(aDocument->mChangedLines)
     , mInsertSpaces(false)
     , mTabSize(4)
     , mHighlightBrackets(false)
@@ -81,14 +244,27 @@ TextEditor::TextEditor()
     , mScrollToCursor(false)
     , mScrollToTop(false)
     , mTextChanged(false)
+    , mTextVersion(aDocument->mTextVersion)
+    , mViewRemapPending(false)
+    , mLineOffsets(aDocument->mLineOffsets)
+    , mLineOffsetsVersion(aDocument->mLineOffsetsVersion)
     , mColorizerEnabled(true)
     , mTextStart(20.0f)
     , mLeftMargin(DebugDataSpace + LineNumberSpace)
     , mCursorPositionChanged(false)
-    , mColorRangeMin(0)
-    , mColorRangeMax(0)
+    , mColorRangeMin(aDocument->mColorRangeMin)
+    , mColorRangeMax(aDocument->mColorRangeMax)
     , mSelectionMode(SelectionMode::Normal)
-    , mCheckComments(true)
+    , mBreakpoints(aDocument->mBreakpoints)
+    , mCheckComments(aDocument->mCheckComments)
+    , mCommentScanFrom(aDocument->mCommentScanFrom)
+    , mTailCommentLine(aDocument->mTailCommentLine)
+    , mTailCommentState(aDocument->mTailCommentState)
+    , mMaxLineCount(0)
+    , mAutoScroll(true)
+    , mPinnedToBottom(true)
+    , mScrollToBottom(false)
+    , mErrorMarkers(aDocument->mErrorMarkers)
     , mLastClick(-1.0f)
     , mHandleKeyboardInputs(true)
     , mHandleMouseInputs(true)
@@ -99,6 +275,11 @@ TextEditor::TextEditor()
     , mDebugCurrentLine(-1)
     , mPath("")
     , OnContentUpdate(nullptr)
+    , OnTextChanges(nullptr)
+    , OnLoadProgress(nullptr)
+    , OnFileViewFind(nullptr)
+    , OnFileReload(nullptr)
+    , OnFileConflict(nullptr)
     , mFuncTooltips(true)
     , mUIScale(1.0f)
     , mUIFontSize(18.0f)
@@ -110,14 +291,27 @@ TextEditor::TextEditor()
     , mAutoindentOnPaste(false)
     , mFunctionDeclarationTooltip(false)
     , mFunctionDeclarationTooltipEnabled(false)
+    , mACCandidatesDirty(true)
+    , mACProvider(nullptr)
+    , mACExecutor(nullptr)
+    , mACProviderDelay(0)
     , mIsSnippet(false)
     , mSnippetTagSelected(0)
     , mSidebar(true)
     , mHasSearch(true)
-    , mReplaceIndex(0)
+    , mFindRegex(false)
+    , mFindCaseSensitive(false)
+    , mSearchDone(false)
+    , mSearchAction(SearchAction::None)
+    , mLoadFirstChunk(false)
+    , mFileViewScrollTo(-1)
+    , mFileViewTopLine(0)
+    , mFileWatchDelay(FileWatchDelay)
+    , mFileVersion(0)
+    , mFileSavedHash(0)
+    , mFileSaved(false)
     , mFoldEnabled(true)
     , mFoldLastIteration(0)
-    , mFoldSorted(false)
     , mLastScroll(0.0f)
     , mStartTime(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count())
 {
@@ -144,10 +338,12 @@ TextEditor::TextEditor()
     mDebugBarHeight = 0.0f;
 
     SetPalette(GetDarkPalette());
-    SetLanguageDefinition(HLSL());
-    mLines.push_back(Line());
+    SetLanguageDefinition(HLSL());
+    mDocument->mViews.push_back(this);
 
     m_shortcuts = GetDefaultShortcuts();
+    mShortcutTableDirty = true;
+    mRecordingInput = false;
 }
 
 const std::vector<Shortcut> GetDefaultShortcuts()
@@ -280,6 +476,17 @@ const std::vector<Shortcut> GetDefaultShortcuts()
 
 TextEditor::~TextEditor()
 {
+    auto& views = mDocument->mViews;
+    views.erase(std::remove(views.begin(), views.end(), this), views.end());
+
+    mCancelSearch();
+    if (mLoadJob != nullptr)
+        mLoadJob->mCancel = true;
+    if (mFileView != nullptr)
+        mFileView->mCancel = true;
+    if (mFileWatch != nullptr)
+        mFileWatch->mCancel = true;
+    mCancelACProvider();
 }
 
 void TextEditor::SetLanguageDefinition(const LanguageDefinition & aLanguageDef)
@@ -290,6 +497,8 @@ void TextEditor::SetLanguageDefinition(const LanguageDefinition & aLanguageDef)
     for (auto& r : mLanguageDefinition.mTokenRegexStrings)
         mRegexList.push_back(std::make_pair(std::regex(r.first, std::regex_constants::optimize), r.second));
 
+    mACCandidatesDirty = true;
+    mExpressionCache.clear();
     Colorize();
 }
 
@@ -301,39 +510,83 @@ void TextEditor::SetPalette(const Palette & aValue)
 std::string TextEditor::GetText(const Coordinates & aStart, const Coordinates & aEnd) const
 {
     std::string result;
+    if (aStart.mLine >= (int)mLines.size() || aEnd < aStart)
+        return result;
 
     auto lstart = aStart.mLine;
     auto lend = aEnd.mLine;
     auto istart = GetCharacterIndex(aStart);
     auto iend = GetCharacterIndex(aEnd);
-    size_t s = 0;
 
-    for (size_t i = lstart; i < lend; i++)
-        s += mLines[i].size();
+    // an end past the last line is the end of the document
+    if (lend >= (int)mLines.size()) {
+        lend = (int)mLines.size() - 1;
+        iend = (int)mLines[lend].size();
+    }
 
-    result.reserve(s + s / 8);
+    // sized up front in 64 bits, the range can exceed the int limits
+    uint64_t size = 0;
+    for (int i = lstart; i <= lend; i++)
+        size += mLines[i].size() + 1;
+    result.reserve((size_t)size);
+
+    for (int ln = lstart; ln <= lend; ln++) {
+        auto& line = mLines[ln];
+        int from = ln == lstart ? istart : 0;
+        int to = ln == lend ? std::min<int>(iend, (int)line.size()) : (int)line.size();
+        for (int i = from; i < to; i++)
+            result += line[i].mChar;
+
+        if (ln < lend)
+            result += '\n';
+    }
 
-    while (istart < iend || lstart < lend)
-    {
-        if (lstart >= (int)mLines.size())
-            break;
+    return result;
+}
 
-        auto& line = mLines[lstart];
-        if (istart < (int)line.size())
-        {
-            result += line[istart].mChar;
-            istart++;
-        }
-        else
-        {
-            istart = 0;
-            if (!(lstart == lend-1 && iend == -1))
-                result += '\n';
-            ++lstart;
-        }
+void TextEditor::UpdateLineOffsets() const
+{
+    if (mLineOffsetsVersion == mTextVersion && mLineOffsets.size() == mLines.size() + 1)
+        return;
+
+    mLineOffsets.resize(mLines.size() + 1);
+    uint64_t offset = 0;
+    for (size_t i = 0; i < mLines.size(); i++) {
+        mLineOffsets[i] = offset;
+        offset += mLines[i].size() + 1;
     }
+    mLineOffsets[mLines.size()] = offset;
+    mLineOffsetsVersion = mTextVersion;
+}
 
-    return result;
+uint64_t TextEditor::GetTextSize() const
+{
+    if (mLines.empty())
+        return 0;
+
+    UpdateLineOffsets();
+    return mLineOffsets.back() - 1; // no line break after the last line
+}
+
+uint64_t TextEditor::GetOffset(const Coordinates& aPosition) const
+{
+    if (mLines.empty())
+        return 0;
+
+    auto position = SanitizeCoordinates(aPosition);
+    UpdateLineOffsets();
+    return mLineOffsets[position.mLine] + GetCharacterIndex(position);
+}
+
+Coordinates TextEditor::GetCoordinates(uint64_t aOffset) const
+{
+    if (mLines.empty())
+        return Coordinates();
+
+    UpdateLineOffsets();
+    int line = (int)(std::upper_bound(mLineOffsets.begin(), mLineOffsets.end() - 1, aOffset) - mLineOffsets.begin()) - 1;
+    int index = (int)std::min<uint64_t>(aOffset - mLineOffsets[line], mLines[line].size());
+    return Coordinates(line, GetCharacterColumn(line, index));
 }
 
 Coordinates TextEditor::GetActualCursorCoordinates() const
@@ -383,6 +636,11 @@ static int UTF8CharLength(TextEditor::Char c)
     return 1;
 }
 
+static bool IsUTFSequence(char c)
+{
+    return (c & 0xC0) == 0x80;
+}
+
 // "Borrowed" from ImGui source
 static inline int ImTextCharToUtf8(char* buf, int buf_size, unsigned int c)
 {
@@ -450,9 +708,14 @@ void TextEditor::DeleteRange(const Coordinates& aStart, const Coordinates& aEnd)
     if (aEnd == aStart)
         return;
 
+    auto changeEnd = SanitizeCoordinates(aEnd);
+    changeEnd.mColumn = GetCharacterIndex(changeEnd);
+
     auto start = GetCharacterIndex(aStart);
     auto end = GetCharacterIndex(aEnd);
 
+    BeginViewRemap();
+
     if (aStart.mLine == aEnd.mLine) {
         auto& line = mLines[aStart.mLine];
         auto n = GetLineMaxColumn(aStart.mLine);
@@ -480,28 +743,17 @@ void TextEditor::DeleteRange(const Coordinates& aStart, const Coordinates& aEnd)
         }
     }
 
-    if (mScrollbarMarkers) {
-        for (int i = 0; i < mChangedLines.size(); i++) {
-            if (mChangedLines[i] > aEnd.mLine)
-                mChangedLines[i] -= (aEnd.mLine - aStart.mLine);
-            else if (mChangedLines[i] > aStart.mLine && mChangedLines[i] < aEnd.mLine) {
-                mChangedLines.erase(mChangedLines.begin() + i);
-                i--;
-            }
-        }
-    }
+    if (mEditDepth == 0)
+        InvalidateSnapshotLines(aStart.mLine, aStart.mLine + 1);
 
-    mTextChanged = true;
-    if (OnContentUpdate != nullptr)
-        OnContentUpdate(this);
+    MarkTextChanged();
+    AddTextChange(Coordinates(aStart.mLine, start), changeEnd, std::string());
 }
 
-int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValue, bool indent)
+std::string TextEditor::AutoIndentText(const Coordinates& aWhere, const char* aValue, std::vector<int>& aIndents) const
 {
-    assert(!mReadOnly);
-
     int autoIndentStart = 0;
-    for (int i = 0; i < mLines[aWhere.mLine].size() && indent; i++) {
+    for (int i = 0; i < mLines[aWhere.mLine].size(); i++) {
         Char ch = mLines[aWhere.mLine][i].mChar;
         if (ch == ' ')
             autoIndentStart++;
@@ -510,146 +762,161 @@ int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValu
         else break;
     }
 
-    int cindex = GetCharacterIndex(aWhere);
-    int totalLines = 0;
+    std::string result;
+    result.reserve(strlen(aValue));
+
     int autoIndent = autoIndentStart;
     while (*aValue != '\0')
     {
-        assert(!mLines.empty());
-
-        if (*aValue == '\r')
-        {
-            // skip
-            ++aValue;
-        }
-        else if (*aValue == '\n')
+        if (*aValue == '\n')
         {
-            if (cindex < (int)mLines[aWhere.mLine].size() && cindex >= 0) {
-                // normal stuff
-                auto& newLine = InsertLine(aWhere.mLine + 1, aWhere.mColumn);
-                auto& line = mLines[aWhere.mLine];
-                newLine.insert(newLine.begin(), line.begin() + cindex, line.end());
-                line.erase(line.begin() + cindex, line.end());
+            result += *aValue++;
 
-                
-                // folding
-                for (int b = 0; b < mFoldBegin.size(); b++)
-                    if (mFoldBegin[b].mLine == aWhere.mLine + 1 && mFoldBegin[b].mColumn >= aWhere.mColumn)
-                        mFoldBegin[b].mColumn = std::max<int>(0, mFoldBegin[b].mColumn - aWhere.mColumn);
-                for (int b = 0; b < mFoldEnd.size(); b++)
-                    if (mFoldEnd[b].mLine == aWhere.mLine + 1 && mFoldEnd[b].mColumn >= aWhere.mColumn)
-                        mFoldEnd[b].mColumn = std::max<int>(0, mFoldEnd[b].mColumn - aWhere.mColumn);
-
-            }
-            else
-            {
-                InsertLine(aWhere.mLine + 1, aWhere.mColumn);
-            }
-            ++aWhere.mLine;
-            cindex = 0;
-            aWhere.mColumn = 0;
-            ++totalLines;
-            ++aValue;
-
-            if (indent) {
-                bool lineIsAlreadyIndent = (isspace(*aValue) && *aValue != '\n' && *aValue != '\r');
-
-                // first check if we need to "unindent"
-                const char* bracketSearch = aValue;
-                while (*bracketSearch != '\0' && isspace(*bracketSearch) && *bracketSearch != '\n')
-                    bracketSearch++;
-                if (*bracketSearch == '}')
-                    autoIndent = std::max(0, autoIndent - mTabSize);
-
-                int actualAutoIndent = autoIndent;
-                if (lineIsAlreadyIndent) {
-                    actualAutoIndent = autoIndentStart;
-
-                    const char* aValueCopy = aValue;
-                    while (isspace(*aValueCopy) && *aValueCopy != '\n' && *aValueCopy != '\r' && *aValueCopy != 0) {
-                        actualAutoIndent = std::max(0, actualAutoIndent - mTabSize);
-                        aValueCopy++;
-                    }
-                }
+            bool lineIsAlreadyIndent = (isspace(*aValue) && *aValue != '\n' && *aValue != '\r');
 
-                // add tabs
-                int tabCount = actualAutoIndent / mTabSize;
-                int spaceCount = actualAutoIndent - tabCount * mTabSize;
-                if (mInsertSpaces) {
-                    tabCount = 0;
-                    spaceCount = actualAutoIndent;
-                }
+            // first check if we need to "unindent"
+            const char* bracketSearch = aValue;
+            while (*bracketSearch != '\0' && isspace(*bracketSearch) && *bracketSearch != '\n')
+                bracketSearch++;
+            if (*bracketSearch == '}')
+                autoIndent = std::max(0, autoIndent - mTabSize);
 
-                cindex = tabCount + spaceCount;
-                aWhere.mColumn = actualAutoIndent;
+            int actualAutoIndent = autoIndent;
+            if (lineIsAlreadyIndent) {
+                actualAutoIndent = autoIndentStart;
 
-                
-                // folding
-                for (int b = 0; b < mFoldBegin.size(); b++)
-                    if (mFoldBegin[b].mLine == aWhere.mLine && mFoldBegin[b].mColumn >= aWhere.mColumn)
-                        mFoldBegin[b].mColumn += spaceCount + tabCount * mTabSize;
-                for (int b = 0; b < mFoldEnd.size(); b++)
-                    if (mFoldEnd[b].mLine == aWhere.mLine && mFoldEnd[b].mColumn >= aWhere.mColumn)
-                        mFoldEnd[b].mColumn += spaceCount + tabCount * mTabSize;
-
-                // insert the spaces/tabs
-                while (spaceCount-- > 0) {
-                    mLines[aWhere.mLine].insert(mLines[aWhere.mLine].begin(), Glyph(' ', PaletteIndex::Default));
-                    for (int i = 0; i < mSnippetTagStart.size(); i++) {
-                        if (mSnippetTagStart[i].mLine == aWhere.mLine) {
-                            mSnippetTagStart[i].mColumn++;
-                            mSnippetTagEnd[i].mColumn++;
-                        }
-                    }
-                }
-                while (tabCount-- > 0) {
-                    mLines[aWhere.mLine].insert(mLines[aWhere.mLine].begin(), Glyph('\t', PaletteIndex::Default));
-                    for (int i = 0; i < mSnippetTagStart.size(); i++) {
-                        if (mSnippetTagStart[i].mLine == aWhere.mLine) {
-                            mSnippetTagStart[i].mColumn += mTabSize;
-                            mSnippetTagEnd[i].mColumn += mTabSize;
-                        }
-                    }
+                const char* aValueCopy = aValue;
+                while (isspace(*aValueCopy) && *aValueCopy != '\n' && *aValueCopy != '\r' && *aValueCopy != 0) {
+                    actualAutoIndent = std::max(0, actualAutoIndent - mTabSize);
+                    aValueCopy++;
                 }
             }
+
+            // add tabs
+            int tabCount = actualAutoIndent / mTabSize;
+            int spaceCount = actualAutoIndent - tabCount * mTabSize;
+            if (mInsertSpaces) {
+                tabCount = 0;
+                spaceCount = actualAutoIndent;
+            }
+
+            result.append(tabCount, '\t');
+            result.append(spaceCount, ' ');
+            aIndents.push_back(spaceCount + tabCount * mTabSize);
         }
         else
         {
-            char aValueOld = *aValue;
-            bool isTab = (aValueOld == '\t');
-            auto& line = mLines[aWhere.mLine];
-            auto d = UTF8CharLength(aValueOld);
-            int foldOffset = 0;
-            while (d-- > 0 && *aValue != '\0') {
-                foldOffset += (*aValue == '\t') ? mTabSize : 1;
-                line.insert(line.begin() + cindex++, Glyph(*aValue++, PaletteIndex::Default));
-            }
+            if (*aValue == '{')
+                autoIndent += mTabSize;
+            else if (*aValue == '}')
+                autoIndent = std::max(0, autoIndent - mTabSize);
 
-            // shift old fold info
-            for (int i = 0; i < mFoldBegin.size(); i++)
-                if (mFoldBegin[i].mLine == aWhere.mLine && mFoldBegin[i].mColumn >= aWhere.mColumn)
-                    mFoldBegin[i].mColumn += foldOffset;
-            for (int i = 0; i < mFoldEnd.size(); i++)
-                if (mFoldEnd[i].mLine == aWhere.mLine && mFoldEnd[i].mColumn >= aWhere.mColumn)
-                    mFoldEnd[i].mColumn += foldOffset;
+            result += *aValue++;
+        }
+    }
 
-            // insert new fold info
-            if (aValueOld == '{') {
-                autoIndent += mTabSize;
+    return result;
+}
 
-                mFoldBegin.push_back(aWhere);
-                mFoldSorted = false;
-            } else if (aValueOld == '}') {
-                autoIndent = std::max(0, autoIndent - mTabSize);
+int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValue, bool indent)
+{
+    assert(!mReadOnly);
+    assert(!mLines.empty());
 
-                mFoldEnd.push_back(aWhere);
-                mFoldSorted = false;
-            }
+    std::vector<int> indents;
+    std::string indented;
+    if (indent) {
+        indented = AutoIndentText(aWhere, aValue, indents);
+        aValue = indented.c_str();
+    }
+
+    auto changeStart = aWhere;
+    const char* end = aValue + strlen(aValue);
+
+    // split the text into lines up front, mColumn of the braces holds their glyph index
+    std::vector<Line> lines(1);
+    std::vector<Coordinates> braces;
+    for (const char* p = aValue; ; ) {
+        auto next = (const char*)memchr(p, '\n', end - p);
+        auto lineEnd = next != nullptr ? next : end;
+
+        auto& line = lines.back();
+        line.reserve(lineEnd - p);
+        for (; p < lineEnd; p++) {
+            if (*p == '\r')
+                continue;
+            if (*p == '{' || *p == '}')
+                braces.push_back(Coordinates((int)lines.size() - 1, (int)line.size()));
+            line.emplace_back(Glyph(*p, PaletteIndex::Default));
+        }
+
+        if (next == nullptr)
+            break;
+        p = next + 1;
+        lines.emplace_back();
+    }
 
-            aWhere.mColumn += (isTab ? mTabSize : 1);
+    int cindex = GetCharacterIndex(aWhere);
+    int totalLines = (int)lines.size() - 1;
+    int endIndex = (totalLines == 0 ? cindex : 0) + (int)lines.back().size();
+
+    // folds behind the insertion point move with the text, their column is recomputed once the line is rebuilt
+    std::vector<std::pair<Coordinates*, int>> movedFolds;
+    auto shiftFolds = [&](std::vector<Coordinates>& aFolds) {
+        for (auto& fold : aFolds) {
+            if (fold.mLine > aWhere.mLine)
+                fold.mLine += totalLines;
+            else if (fold.mLine == aWhere.mLine && fold.mColumn >= aWhere.mColumn)
+                movedFolds.push_back(std::make_pair(&fold, endIndex + GetCharacterIndex(fold) - cindex));
+        }
+    };
+    shiftFolds(mFoldBegin);
+    shiftFolds(mFoldEnd);
+
+    BeginViewRemap();
+
+    // splice the new lines in with a single insertion
+    auto& target = mLines[aWhere.mLine];
+    if (totalLines == 0)
+        target.insert(target.begin() + cindex, lines[0].begin(), lines[0].end());
+    else {
+        lines.back().insert(lines.back().end(), target.begin() + cindex, target.end());
+        target.erase(target.begin() + cindex, target.end());
+        target.insert(target.end(), lines[0].begin(), lines[0].end());
+        mLines.insert(mLines.begin() + aWhere.mLine + 1, std::make_move_iterator(lines.begin() + 1), std::make_move_iterator(lines.end()));
+
+        // error markers, breakpoints and scrollbar markers
+        ShiftLines(aWhere.mLine + 1, totalLines);
+    }
+
+    int endLine = aWhere.mLine + totalLines;
+    for (auto& fold : movedFolds)
+        *fold.first = Coordinates(endLine, GetCharacterColumn(endLine, fold.second));
+
+    // insert new fold info
+    for (auto& brace : braces) {
+        int line = aWhere.mLine + brace.mLine;
+        int index = brace.mColumn + (brace.mLine == 0 ? cindex : 0);
+        Coordinates coord(line, GetCharacterColumn(line, index));
+        if (mLines[line][index].mChar == '{')
+            mFoldBegin.push_back(coord);
+        else
+            mFoldEnd.push_back(coord);
+        mFoldSorted = false;
+    }
+
+    // snippet tags on the new lines move with the indentation
+    for (int i = 0; i < (int)indents.size(); i++) {
+        for (int j = 0; j < mSnippetTagStart.size(); j++) {
+            if (mSnippetTagStart[j].mLine == aWhere.mLine + i + 1) {
+                mSnippetTagStart[j].mColumn += indents[i];
+                mSnippetTagEnd[j].mColumn += indents[i];
+            }
         }
     }
 
+    aWhere = Coordinates(endLine, GetCharacterColumn(endLine, endIndex));
+
     if (mScrollbarMarkers) {
         bool changeExists = false;
         for (int i = 0; i < mChangedLines.size(); i++) {
@@ -662,9 +929,13 @@ int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValu
             mChangedLines.push_back(aWhere.mLine);
     }
 
-    mTextChanged = true;
-    if (OnContentUpdate != nullptr)
-        OnContentUpdate(this);
+    // inside BeginEdit()/EndEdit() the line shifts are still pending, EndEdit() colorizes the edited lines
+    if (mEditDepth == 0)
+        InvalidateSnapshotLines(changeStart.mLine, aWhere.mLine + 1);
+
+    MarkTextChanged();
+    if (WantsTextChanges())
+        AddTextChange(Coordinates(changeStart.mLine, cindex), Coordinates(changeStart.mLine, cindex), GetText(changeStart, aWhere));
 
     return totalLines;
 }
@@ -672,6 +943,12 @@ int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValu
 void TextEditor::AddUndo(UndoRecord& aValue)
 {
     assert(!mReadOnly);
+
+    if (mEditDepth > 0) {
+        mEditUndo.mOperations.push_back(aValue);
+        return;
+    }
+
     //printf("AddUndo: (@%d.%d) +\'%s' [%d.%d .. %d.%d], -\'%s', [%d.%d .. %d.%d] (@%d.%d)\n",
     //  aValue.mBefore.mCursorPosition.mLine, aValue.mBefore.mCursorPosition.mColumn,
     //  aValue.mAdded.c_str(), aValue.mAddedStart.mLine, aValue.mAddedStart.mColumn, aValue.mAddedEnd.mLine, aValue.mAddedEnd.mColumn,
@@ -684,97 +961,536 @@ void TextEditor::AddUndo(UndoRecord& aValue)
     ++mUndoIndex;
 }
 
-Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPosition) const
+void TextEditor::MarkTextChanged()
 {
-    ImVec2 origin = mUICursorPos;
-    ImVec2 local(aPosition.x - origin.x, aPosition.y - origin.y);
+    mTextChanged = true;
+    mTextVersion++;
+    mSeenTextVersion = mTextVersion;
 
-    int lineNo = std::max(0, (int)floor(local.y / mCharAdvance.y));
-    int columnCoord = 0;
+    if (mEditDepth > 0)
+        mEditContentChanged = true;
+    else
+        NotifyContentUpdate();
+}
 
-    // check for folds
-    if (mFoldEnabled) {
-        auto foldLineStart = 0;
-        auto foldLineEnd = std::min<int>((int)mLines.size() - 1, lineNo);
-        while (foldLineStart < foldLineEnd) {
-            // check if line is folded
-            for (int i = 0; i < mFoldBegin.size(); i++) {
-                if (mFoldBegin[i].mLine == foldLineStart) {
-                    if (i < mFold.size() && mFold[i]) {
-                        int foldCon = mFoldConnection[i];
-                        if (foldCon != -1 && foldCon < mFoldEnd.size()) {
-                            int diff = mFoldEnd[foldCon].mLine - mFoldBegin[i].mLine;
-                            lineNo += diff;
-                            foldLineEnd = std::min<int>((int)mLines.size() - 1, foldLineEnd + diff);
-                        }
-                        break;
-                    }
-                }
-            }
-            foldLineStart++;
-        }
+void TextEditor::NotifyContentUpdate()
+{
+    for (size_t i = 0; i < mDocument->mViews.size(); i++) {
+        auto* view = mDocument->mViews[i];
+        if (view->OnContentUpdate != nullptr)
+            view->OnContentUpdate(view);
     }
+}
 
-    if (lineNo >= 0 && lineNo < (int)mLines.size())
-    {
-        auto& line = mLines.at(lineNo);
+bool TextEditor::WantsTextChanges() const
+{
+    // other views follow the changes with their cursors
+    if (mDocument->mViews.size() > 1)
+        return true;
+    for (auto* view : mDocument->mViews)
+        if (view->OnTextChanges != nullptr)
+            return true;
+    return false;
+}
 
-        int columnIndex = 0;
-        float columnX = 0.0f;
+// end of aText inserted at aStart, both in glyph indices like the TextChange columns
+static Coordinates GetTextEndIndex(const Coordinates& aStart, const std::string& aText)
+{
+    Coordinates end = aStart;
+    for (char c : aText) {
+        if (c == '\n') {
+            end.mLine++;
+            end.mColumn = 0;
+        } else if (c != '\r')
+            end.mColumn++;
+    }
+    return end;
+}
+
+void TextEditor::AddTextChange(const Coordinates& aStart, const Coordinates& aEnd, const std::string& aText)
+{
+    // every view of the document reports the change to its own listener
+    for (auto* view : mDocument->mViews)
+        if (view->OnTextChanges != nullptr)
+            view->QueueTextChange(aStart, aEnd, aText);
+
+    // the other views move their positions with the change, positions inside the replaced range go to its end
+    Coordinates addedEnd = GetTextEndIndex(aStart, aText);
+    for (auto* view : mDocument->mViews) {
+        if (view == this || !view->mViewRemapPending)
+            continue;
 
-        while ((size_t)columnIndex < line.size())
-        {
-            float columnWidth = 0.0f;
+        for (auto& pos : view->mViewRemap) {
+            if (pos <= aStart)
+                continue;
 
-            if (line[columnIndex].mChar == '\t')
-            {
-                float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ").x;
-                float oldX = columnX;
-                float newColumnX = (1.0f + std::floor((1.0f + columnX) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-                columnWidth = newColumnX - oldX;
-                if (mTextStart + columnX + columnWidth * 0.5f > local.x)
-                    break;
-                columnX = newColumnX;
-                columnCoord = (columnCoord / mTabSize) * mTabSize + mTabSize;
-                columnIndex++;
-            }
+            if (pos < aEnd)
+                pos = addedEnd;
+            else if (pos.mLine == aEnd.mLine)
+                pos = Coordinates(addedEnd.mLine, addedEnd.mColumn + pos.mColumn - aEnd.mColumn);
             else
-            {
-                char buf[7];
-                auto d = UTF8CharLength(line[columnIndex].mChar);
-                int i = 0;
-                while (i < 6 && d-- > 0)
-                    buf[i++] = line[columnIndex++].mChar;
-                buf[i] = '\0';
-                columnWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf).x;
-                if (mTextStart + columnX + columnWidth * 0.5f > local.x)
-                    break;
-                columnX += columnWidth;
-                columnCoord++;
-            }
+                pos.mLine += (addedEnd.mLine - aStart.mLine) - (aEnd.mLine - aStart.mLine);
         }
     }
 
-    return SanitizeCoordinates(Coordinates(lineNo, columnCoord));
+    if (mEditDepth == 0)
+        EndViewRemap();
 }
-Coordinates TextEditor::MousePosToCoordinates(const ImVec2& aPosition) const
+
+std::array<Coordinates*, 5> TextEditor::GetViewPositions()
 {
-    ImVec2 origin = mUICursorPos;
-    ImVec2 local(aPosition.x - origin.x, aPosition.y - origin.y);
+    return { &mState.mCursorPosition, &mState.mSelectionStart, &mState.mSelectionEnd, &mInteractiveStart, &mInteractiveEnd };
+}
 
-    int lineNo = std::max(0, (int)floor(local.y / mCharAdvance.y));
-    int columnCoord = 0;
-    int modifier = 0;
+void TextEditor::BeginViewRemap()
+{
+    // the columns of the other views are tab-expanded, they are converted while the text still matches them
+    for (auto* view : mDocument->mViews) {
+        if (view == this || view->mViewRemapPending)
+            continue;
 
-    // check for folds
-    if (mFoldEnabled) {
-        auto foldLineStart = 0;
-        auto foldLineEnd = std::min<int>((int)mLines.size() - 1, lineNo);
-        while (foldLineStart < foldLineEnd) {
-            // check if line is folded
-            for (int i = 0; i < mFoldBegin.size(); i++) {
-                if (mFoldBegin[i].mLine == foldLineStart) {
-                    if (i < mFold.size() && mFold[i]) {
+        auto positions = view->GetViewPositions();
+        for (size_t i = 0; i < positions.size(); i++) {
+            auto pos = view->SanitizeCoordinates(*positions[i]);
+            view->mViewRemap[i] = Coordinates(pos.mLine, view->GetCharacterIndex(pos));
+        }
+        view->mViewRemapPending = true;
+    }
+}
+
+void TextEditor::EndViewRemap()
+{
+    for (auto* view : mDocument->mViews) {
+        if (!view->mViewRemapPending)
+            continue;
+
+        auto positions = view->GetViewPositions();
+        for (size_t i = 0; i < positions.size(); i++) {
+            auto& pos = view->mViewRemap[i];
+            *positions[i] = view->SanitizeCoordinates(Coordinates(pos.mLine, view->GetCharacterColumn(pos.mLine, pos.mColumn)));
+        }
+        view->mViewRemapPending = false;
+    }
+}
+
+void TextEditor::QueueTextChange(const Coordinates& aStart, const Coordinates& aEnd, const std::string& aText)
+{
+    if (!mTextChanges.empty()) {
+        auto& prev = mTextChanges.back();
+
+        // typing: an insertion right after the previous insertion extends it
+        if (aStart == aEnd && prev.mStart == prev.mEnd && !aText.empty() && !prev.mText.empty()) {
+            if (GetTextEndIndex(prev.mStart, prev.mText) == aStart) {
+                prev.mText += aText;
+                prev.mVersion = mTextVersion;
+                return;
+            }
+        }
+
+        // backspacing: a deletion ending where the previous deletion started extends it
+        if (aText.empty() && prev.mText.empty() && aEnd == prev.mStart) {
+            prev.mStart = aStart;
+            prev.mVersion = mTextVersion;
+            return;
+        }
+    }
+
+    TextChange change;
+    change.mStart = aStart;
+    change.mEnd = aEnd;
+    change.mText = aText;
+    change.mVersion = mTextVersion;
+    mTextChanges.push_back(std::move(change));
+}
+
+Coordinates TextEditor::GetTextEnd(const Coordinates& aStart, const std::string& aText) const
+{
+    Coordinates end = aStart;
+    for (char c : aText) {
+        if (c == '\n') {
+            end.mLine++;
+            end.mColumn = 0;
+        } else if (c == '\t')
+            end.mColumn = (end.mColumn / mTabSize) * mTabSize + mTabSize;
+        else if (c != '\r' && !IsUTFSequence(c))
+            end.mColumn++;
+    }
+    return end;
+}
+
+void TextEditor::FlushTextChanges()
+{
+    // the views that are not rendered this frame get their changes too
+    for (size_t i = 0; i < mDocument->mViews.size(); i++) {
+        auto* view = mDocument->mViews[i];
+        if (view->mTextChanges.empty())
+            continue;
+
+        std::vector<TextChange> changes;
+        changes.swap(view->mTextChanges);
+
+        if (view->OnTextChanges != nullptr)
+            view->OnTextChanges(view, changes);
+    }
+}
+
+// breakpoints are kept sorted by line
+static bool BreakpointBefore(const TextEditor::Breakpoint& aBreakpoint, int aLine)
+{
+    return aBreakpoint.mLine < aLine;
+}
+
+void TextEditor::BeginEdit()
+{
+    if (mEditDepth++ > 0)
+        return;
+
+    mEditContentChanged = false;
+    mEditLineMin = std::numeric_limits<int>::max();
+    mEditLineMax = -1;
+    mEditUndo = UndoRecord();
+    mEditUndo.mBefore = mState;
+
+    // set the bookkeeping aside so that edits inside the batch don't walk it, EndEdit() remaps it once
+    std::swap(mFoldBegin, mEditFoldBegin);
+    std::swap(mFoldEnd, mEditFoldEnd);
+    std::swap(mErrorMarkers, mEditErrorMarkers);
+    std::swap(mBreakpoints, mEditBreakpoints);
+    std::swap(mChangedLines, mEditChangedLines);
+}
+
+void TextEditor::EndEdit()
+{
+    assert(mEditDepth > 0);
+    if (--mEditDepth > 0)
+        return;
+
+    int lineMin = std::max<int>(0, mEditLineMin);
+    int lineMax = std::min<int>((int)mLines.size(), mEditLineMax);
+
+    // folds: move the ones outside of the edited lines, rescan the edited lines
+    mFoldBegin.clear();
+    mFoldEnd.clear();
+    for (auto& fold : mEditFoldBegin) {
+        int line = RemapLine(fold.mLine);
+        if (line >= 0 && (line < lineMin || line >= lineMax))
+            mFoldBegin.push_back(Coordinates(line, fold.mColumn));
+    }
+    for (auto& fold : mEditFoldEnd) {
+        int line = RemapLine(fold.mLine);
+        if (line >= 0 && (line < lineMin || line >= lineMax))
+            mFoldEnd.push_back(Coordinates(line, fold.mColumn));
+    }
+    for (int ln = lineMin; ln < lineMax; ln++) {
+        auto& line = mLines[ln];
+        int column = 0;
+        for (int i = 0; i < (int)line.size(); i += UTF8CharLength(line[i].mChar)) {
+            auto c = line[i].mChar;
+            if (c == '{')
+                mFoldBegin.push_back(Coordinates(ln, column));
+            else if (c == '}')
+                mFoldEnd.push_back(Coordinates(ln, column));
+
+            if (c == '\t')
+                column = (column / mTabSize) * mTabSize + mTabSize;
+            else
+                column++;
+        }
+    }
+    mEditFoldBegin.clear();
+    mEditFoldEnd.clear();
+    mFoldSorted = false;
+
+    // error markers, breakpoints and scrollbar markers: a single pass over the recorded line shifts
+    std::swap(mErrorMarkers, mEditErrorMarkers);
+    std::swap(mBreakpoints, mEditBreakpoints);
+    std::swap(mChangedLines, mEditChangedLines);
+    ApplyLineShifts();
+    EndViewRemap();
+    for (auto& marker : mEditErrorMarkers)
+        mErrorMarkers[marker.first] = marker.second; // set during the batch, already in final coordinates
+    mEditErrorMarkers.clear();
+
+    // breakpoints removed or set during the batch are in final coordinates too and win over the remapped ones
+    for (int line : mEditRemovedBreakpoints) {
+        int index = FindBreakpoint(line);
+        if (index >= 0) {
+            mBreakpoints.erase(mBreakpoints.begin() + index);
+            if (OnBreakpointRemove)
+                OnBreakpointRemove(this, line);
+        }
+    }
+    for (auto& bkpt : mEditBreakpoints) {
+        auto it = std::lower_bound(mBreakpoints.begin(), mBreakpoints.end(), bkpt.mLine, BreakpointBefore);
+        if (it != mBreakpoints.end() && it->mLine == bkpt.mLine)
+            *it = std::move(bkpt);
+        else
+            it = mBreakpoints.insert(it, std::move(bkpt));
+
+        // reported again since the remapping above may have reported another breakpoint on this line
+        if (OnBreakpointUpdate)
+            OnBreakpointUpdate(this, it->mLine, it->mUseCondition, it->mCondition, it->mEnabled);
+    }
+    mEditBreakpoints.clear();
+    mEditRemovedBreakpoints.clear();
+    mEditChangedLines.clear();
+
+    if (mScrollbarMarkers && lineMin < lineMax) {
+        for (int ln = lineMin; ln < lineMax; ln++)
+            mChangedLines.push_back(ln);
+        std::sort(mChangedLines.begin(), mChangedLines.end());
+        mChangedLines.erase(std::unique(mChangedLines.begin(), mChangedLines.end()), mChangedLines.end());
+    }
+
+    if (lineMin < lineMax)
+        Colorize(lineMin, lineMax - lineMin);
+
+    if (!mEditUndo.mOperations.empty()) {
+        mEditUndo.mAfter = mState;
+        AddUndo(mEditUndo);
+    }
+    mEditUndo = UndoRecord();
+
+    if (mEditContentChanged)
+        NotifyContentUpdate();
+    mEditContentChanged = false;
+}
+
+void TextEditor::ShiftLines(int aIndex, int aCount)
+{
+    // InsertTextAt()/RemoveLine() produce runs of single line shifts, keep them as one entry
+    LineShift* last = mLineShifts.empty() ? nullptr : &mLineShifts.back();
+    if (last != nullptr && aCount > 0 && last->mCount > 0 && aIndex == last->mIndex + last->mCount)
+        last->mCount += aCount;
+    else if (last != nullptr && aCount < 0 && last->mCount < 0 && aIndex == last->mIndex)
+        last->mCount += aCount;
+    else
+        mLineShifts.push_back({ aIndex, aCount });
+
+    if (mEditDepth == 0) {
+        ApplyLineShifts();
+        return;
+    }
+
+    // keep the edited range in current line numbers
+    if (mEditLineMin < mEditLineMax) {
+        auto shift = [&](int& line) {
+            if (aCount > 0) {
+                if (line >= aIndex)
+                    line += aCount;
+            } else if (line >= aIndex - aCount)
+                line += aCount;
+            else if (line > aIndex)
+                line = aIndex;
+        };
+        shift(mEditLineMin);
+        shift(mEditLineMax);
+    }
+    mEditLineMin = std::min<int>(mEditLineMin, aIndex);
+    mEditLineMax = std::max<int>(mEditLineMax, aIndex + std::max<int>(aCount, 1));
+}
+
+int TextEditor::RemapLine(int aLine) const
+{
+    for (auto& shift : mLineShifts) {
+        if (shift.mCount > 0) {
+            if (aLine >= shift.mIndex)
+                aLine += shift.mCount;
+        } else if (aLine >= shift.mIndex - shift.mCount)
+            aLine += shift.mCount;
+        else if (aLine >= shift.mIndex)
+            return -1;
+    }
+    return aLine;
+}
+
+void TextEditor::ApplyLineShifts()
+{
+    if (mLineShifts.empty())
+        return;
+
+    // error markers and breakpoints use 1-based line numbers
+    ErrorMarkers etmp;
+    for (auto& i : mErrorMarkers) {
+        int line = RemapLine(i.first - 1);
+        if (line >= 0)
+            etmp.insert(ErrorMarkers::value_type(line + 1, i.second));
+    }
+    mErrorMarkers = std::move(etmp);
+
+    // the remapping keeps the order, breakpoints above the first shift don't move; removed ones are compacted away
+    int firstShift = std::numeric_limits<int>::max();
+    for (auto& shift : mLineShifts)
+        firstShift = std::min<int>(firstShift, shift.mIndex);
+    size_t kept = std::lower_bound(mBreakpoints.begin(), mBreakpoints.end(), firstShift + 1, BreakpointBefore) - mBreakpoints.begin();
+    for (size_t i = kept; i < mBreakpoints.size(); i++) {
+        auto& bkpt = mBreakpoints[i];
+        int oldLine = bkpt.mLine;
+        int line = RemapLine(oldLine - 1) + 1;
+        if (line != oldLine) {
+            if (OnBreakpointRemove)
+                OnBreakpointRemove(this, oldLine);
+            if (line == 0)
+                continue;
+
+            bkpt.mLine = line;
+            if (OnBreakpointUpdate)
+                OnBreakpointUpdate(this, line, bkpt.mUseCondition, bkpt.mCondition, bkpt.mEnabled);
+        }
+        if (kept != i)
+            mBreakpoints[kept] = std::move(bkpt);
+        kept++;
+    }
+    mBreakpoints.erase(mBreakpoints.begin() + kept, mBreakpoints.end());
+
+    int count = 0;
+    for (int line : mChangedLines) {
+        line = RemapLine(line);
+        if (line >= 0)
+            mChangedLines[count++] = line;
+    }
+    mChangedLines.resize(count);
+
+    // keep the line copies of the snapshots aligned so that unchanged lines are still shared
+    auto& snapshotLines = mDocument->mSnapshotLines;
+    mDocument->mSnapshotStale = true;
+    if (!snapshotLines.empty()) {
+        for (auto& shift : mLineShifts) {
+            int index = std::min<int>(shift.mIndex, (int)snapshotLines.size());
+            if (shift.mCount > 0)
+                snapshotLines.insert(snapshotLines.begin() + index, shift.mCount, nullptr);
+            else
+                snapshotLines.erase(snapshotLines.begin() + index, snapshotLines.begin() + std::min<int>(index - shift.mCount, (int)snapshotLines.size()));
+        }
+    }
+
+    // the words of removed lines are released, inserted lines get theirs once they are colorized
+    auto& lineWords = mDocument->mLineWords;
+    if (!lineWords.empty()) {
+        for (auto& shift : mLineShifts) {
+            int index = std::min<int>(shift.mIndex, (int)lineWords.size());
+            if (shift.mCount > 0)
+                lineWords.insert(lineWords.begin() + index, shift.mCount, std::vector<int>());
+            else {
+                int end = std::min<int>(index - shift.mCount, (int)lineWords.size());
+                ReleaseLineWords(index, end);
+                lineWords.erase(lineWords.begin() + index, lineWords.begin() + end);
+            }
+        }
+    }
+
+    // other views of the document keep their cursor on the same lines, Render() clamps the columns;
+    // the views remapped by AddTextChange() already follow the edit
+    for (auto* view : mDocument->mViews) {
+        if (view == this || view->mViewRemapPending)
+            continue;
+
+        auto remap = [&](Coordinates& aPosition) {
+            int line = RemapLine(aPosition.mLine);
+            if (line >= 0)
+                aPosition.mLine = line;
+        };
+        remap(view->mState.mCursorPosition);
+        remap(view->mState.mSelectionStart);
+        remap(view->mState.mSelectionEnd);
+        remap(view->mInteractiveStart);
+        remap(view->mInteractiveEnd);
+    }
+
+    mLineShifts.clear();
+}
+
+Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPosition) const
+{
+    ImVec2 origin = mUICursorPos;
+    ImVec2 local(aPosition.x - origin.x, aPosition.y - origin.y);
+
+    int lineNo = std::max(0, (int)floor(local.y / mCharAdvance.y));
+    int columnCoord = 0;
+
+    // check for folds
+    if (mFoldEnabled) {
+        auto foldLineStart = 0;
+        auto foldLineEnd = std::min<int>((int)mLines.size() - 1, lineNo);
+        while (foldLineStart < foldLineEnd) {
+            // check if line is folded
+            for (int i = 0; i < mFoldBegin.size(); i++) {
+                if (mFoldBegin[i].mLine == foldLineStart) {
+                    if (i < mFold.size() && mFold[i]) {
+                        int foldCon = mFoldConnection[i];
+                        if (foldCon != -1 && foldCon < mFoldEnd.size()) {
+                            int diff = mFoldEnd[foldCon].mLine - mFoldBegin[i].mLine;
+                            lineNo += diff;
+                            foldLineEnd = std::min<int>((int)mLines.size() - 1, foldLineEnd + diff);
+                        }
+                        break;
+                    }
+                }
+            }
+            foldLineStart++;
+        }
+    }
+
+    if (lineNo >= 0 && lineNo < (int)mLines.size())
+    {
+        auto& line = mLines.at(lineNo);
+
+        int columnIndex = 0;
+        float columnX = 0.0f;
+
+        while ((size_t)columnIndex < line.size())
+        {
+            float columnWidth = 0.0f;
+
+            if (line[columnIndex].mChar == '\t')
+            {
+                float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ").x;
+                float oldX = columnX;
+                float newColumnX = (1.0f + std::floor((1.0f + columnX) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
+                columnWidth = newColumnX - oldX;
+                if (mTextStart + columnX + columnWidth * 0.5f > local.x)
+                    break;
+                columnX = newColumnX;
+                columnCoord = (columnCoord / mTabSize) * mTabSize + mTabSize;
+                columnIndex++;
+            }
+            else
+            {
+                char buf[7];
+                auto d = UTF8CharLength(line[columnIndex].mChar);
+                int i = 0;
+                while (i < 6 && d-- > 0)
+                    buf[i++] = line[columnIndex++].mChar;
+                buf[i] = '\0';
+                columnWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf).x;
+                if (mTextStart + columnX + columnWidth * 0.5f > local.x)
+                    break;
+                columnX += columnWidth;
+                columnCoord++;
+            }
+        }
+    }
+
+    return SanitizeCoordinates(Coordinates(lineNo, columnCoord));
+}
+Coordinates TextEditor::MousePosToCoordinates(const ImVec2& aPosition) const
+{
+    ImVec2 origin = mUICursorPos;
+    ImVec2 local(aPosition.x - origin.x, aPosition.y - origin.y);
+
+    int lineNo = std::max(0, (int)floor(local.y / mCharAdvance.y));
+    int columnCoord = 0;
+    int modifier = 0;
+
+    // check for folds
+    if (mFoldEnabled) {
+        auto foldLineStart = 0;
+        auto foldLineEnd = std::min<int>((int)mLines.size() - 1, lineNo);
+        while (foldLineStart < foldLineEnd) {
+            // check if line is folded
+            for (int i = 0; i < mFoldBegin.size(); i++) {
+                if (mFoldBegin[i].mLine == foldLineStart) {
+                    if (i < mFold.size() && mFold[i]) {
                         int foldCon = mFoldConnection[i];
                         if (foldCon != -1 && foldCon < mFoldEnd.size()) {
                             int diff = mFoldEnd[foldCon].mLine - mFoldBegin[i].mLine;
@@ -1033,45 +1749,11 @@ void TextEditor::RemoveLine(int aStart, int aEnd)
     assert(aEnd >= aStart);
     assert(mLines.size() > (size_t)(aEnd - aStart));
 
-    ErrorMarkers etmp;
-    for (auto& i : mErrorMarkers)
-    {
-        ErrorMarkers::value_type e(i.first >= aStart ? i.first - 1 : i.first, i.second);
-        if (e.first >= aStart && e.first <= aEnd)
-            continue;
-        etmp.insert(e);
-    }
-    mErrorMarkers = std::move(etmp);
-
-    auto btmp = mBreakpoints;
-    mBreakpoints.clear();
-    for (auto i : btmp)
-    {
-        if (i.mLine >= aStart && i.mLine <= aEnd) {
-            RemoveBreakpoint(i.mLine);
-            continue;
-        }
-        AddBreakpoint(i.mLine >= aStart ? i.mLine - 1 : i.mLine, i.mUseCondition, i.mCondition, i.mEnabled);
-    }
-
     mLines.erase(mLines.begin() + aStart, mLines.begin() + aEnd);
     assert(!mLines.empty());
 
-    // remove scrollbard markers
-    if (mScrollbarMarkers) {
-        for (int i = 0; i < mChangedLines.size(); i++) {
-            if (mChangedLines[i] > aEnd)
-                mChangedLines[i] -= (aEnd - aStart);
-            else if (mChangedLines[i] >= aStart && mChangedLines[i] <= aEnd) {
-                mChangedLines.erase(mChangedLines.begin() + i);
-                i--;
-            }
-        }
-    }
-
-    mTextChanged = true;
-    if (OnContentUpdate != nullptr)
-        OnContentUpdate(this);
+    // error markers, breakpoints and scrollbar markers
+    ShiftLines(aStart, aStart - aEnd);
 }
 
 void TextEditor::RemoveLine(int aIndex)
@@ -1079,49 +1761,14 @@ void TextEditor::RemoveLine(int aIndex)
     assert(!mReadOnly);
     assert(mLines.size() > 1);
 
-    ErrorMarkers etmp;
-    for (auto& i : mErrorMarkers)
-    {
-        ErrorMarkers::value_type e(i.first > aIndex ? i.first - 1 : i.first, i.second);
-        if (e.first - 1 == aIndex)
-            continue;
-        etmp.insert(e);
-    }
-    mErrorMarkers = std::move(etmp);
-
-    auto btmp = mBreakpoints;
-    mBreakpoints.clear();
-    for (auto i : btmp)
-    {
-        if (i.mLine == aIndex) {
-            RemoveBreakpoint(i.mLine);
-            continue;
-        }
-        AddBreakpoint(i.mLine >= aIndex ? i.mLine - 1 : i.mLine, i.mUseCondition, i.mCondition, i.mEnabled);
-    }
-
     mLines.erase(mLines.begin() + aIndex);
     assert(!mLines.empty());
     
     // remove folds
     mRemoveFolds(Coordinates(aIndex, 0), Coordinates(aIndex, 100000));
 
-    // move/remove scrollbar markers
-    if (mScrollbarMarkers) {
-        for (int i = 0; i < mChangedLines.size(); i++) {
-            if (mChangedLines[i] > aIndex)
-                mChangedLines[i]--;
-            else if (mChangedLines[i] == aIndex) {
-                mChangedLines.erase(mChangedLines.begin() + i);
-                i--;
-            }
-
-        }
-    }
-
-    mTextChanged = true;
-    if (OnContentUpdate != nullptr)
-        OnContentUpdate(this);
+    // error markers, breakpoints and scrollbar markers
+    ShiftLines(aIndex, -1);
 }
 
 TextEditor::Line& TextEditor::InsertLine(int aIndex, int column)
@@ -1138,19 +1785,8 @@ TextEditor::Line& TextEditor::InsertLine(int aIndex, int column)
         if (mFoldEnd[b].mLine > aIndex - 1 || (mFoldEnd[b].mLine == aIndex - 1 && mFoldEnd[b].mColumn >= column))
             mFoldEnd[b].mLine++;
 
-    // error markers
-    ErrorMarkers etmp;
-    for (auto& i : mErrorMarkers)
-        etmp.insert(ErrorMarkers::value_type(i.first >= aIndex ? i.first + 1 : i.first, i.second));
-    mErrorMarkers = std::move(etmp);
-
-    // breakpoints
-    auto btmp = mBreakpoints;
-    mBreakpoints.clear();
-    for (auto i : btmp)
-        RemoveBreakpoint(i.mLine);
-    for (auto i : btmp)
-        AddBreakpoint(i.mLine >= aIndex ? i.mLine + 1 : i.mLine, i.mUseCondition, i.mCondition, i.mEnabled);
+    // error markers, breakpoints and scrollbar markers
+    ShiftLines(aIndex, 1);
 
     return result;
 }
@@ -1206,157 +1842,335 @@ Coordinates TextEditor::FindFirst(const std::string& what, const Coordinates& fr
         return Coordinates(mLines.size(), 0);
 
     std::string textSrc = GetText(fromWhere, Coordinates((int)mLines.size(), 0));
+    uint64_t base = GetOffset(fromWhere);
 
-    size_t index = 0;
-    size_t loc = textSrc.find(what);
-    Coordinates ret = fromWhere;
-    while (loc != std::string::npos) {
-        for (; index < loc; index++) {
-            if (textSrc[index] == '\n') {
-                ret.mColumn = 0;
-                ret.mLine++;
-            } else
-                ret.mColumn++;
-        }
-        ret.mColumn = GetCharacterColumn(ret.mLine, ret.mColumn); // ret.mColumn is currently character index, convert it to character column
+    for (size_t loc = textSrc.find(what); loc != std::string::npos; loc = textSrc.find(what, loc + 1)) {
+        Coordinates ret = GetCoordinates(base + loc);
         if (GetWordAt(ret) == what)
             return ret;
-        else
-            loc = textSrc.find(what, loc + 1);
     }
 
     return Coordinates(mLines.size(), 0);
 }
 
-void TextEditor::HandleKeyboardInputs()
+void TextEditor::mCancelSearch()
 {
-    ImGuiIO& io = ImGui::GetIO();
-    auto shift = io.KeyShift;
-    auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
-    auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
-
-    if (ImGui::IsWindowFocused())
-    {
-        if (ImGui::IsWindowHovered())
-            ImGui::SetMouseCursor(ImGuiMouseCursor_TextInput);
-        //ImGui::CaptureKeyboardFromApp(true);
+    if (mSearchJob != nullptr)
+        mSearchJob->mCancel = true;
+    mSearchJob = nullptr;
+    mSearchResults.clear();
+    mSearchDone = false;
+}
 
-        io.WantCaptureKeyboard = true;
+void TextEditor::mStartSearch(bool aReplaceAll)
+{
+    mCancelSearch();
+
+    auto job = std::make_shared<SearchJob>();
+    job->mPattern = mFindWord;
+    job->mReplace = mReplaceWord;
+    job->mRegex = mFindRegex;
+    job->mCaseSensitive = mFindCaseSensitive;
+    job->mReplaceAll = aReplaceAll;
+    job->mVersion = mTextVersion;
+    job->mSnapshot = Snapshot();     // shares the unchanged lines, the text is extracted by the worker
+    mSearchJob = job;
+
+    if (job->mRegex) {
+        try {
+            auto flags = std::regex_constants::ECMAScript;
+            if (!job->mCaseSensitive)
+                flags |= std::regex_constants::icase;
+            job->mExpression = std::regex(job->mPattern, flags);
+        } catch (const std::regex_error&) {
+            job->mInvalid = true;
+            job->mDone = true;
+            return;
+        }
+    }
+
+    std::thread(mRunSearch, job).detach();
+}
+
+void TextEditor::mRunSearch(std::shared_ptr<SearchJob> aJob)
+{
+    const auto& snapshot = *aJob->mSnapshot;
+
+    // the literal search compares lower-cased copies unless the case has to match
+    std::string patternLower = aJob->mPattern;
+    if (!aJob->mCaseSensitive)
+        std::transform(patternLower.begin(), patternLower.end(), patternLower.begin(), ::tolower);
+
+    std::vector<SearchMatch> found;
+    std::string line, lineLower, replacedLine, gap;
+    int replacedFirst = -1, replacedLast = -1;
+    std::string replaced;
+
+    for (int ln = 0; ln < snapshot.GetLineCount(); ln++) {
+        if (aJob->mCancel)
+            return;
+
+        auto& glyphs = snapshot.GetLine(ln);
+        line.resize(glyphs.size());
+        for (size_t i = 0; i < glyphs.size(); i++)
+            line[i] = glyphs[i].mChar;
+        size_t lineMatchStart = found.size();
+        replacedLine.clear();
+        size_t copied = 0;
+
+        if (aJob->mRegex) {
+            for (auto it = std::sregex_iterator(line.begin(), line.end(), aJob->mExpression); it != std::sregex_iterator(); ++it) {
+                if (it->length(0) == 0)
+                    continue;
+
+                int start = (int)it->position(0);
+                int end = start + (int)it->length(0);
+                found.push_back({ ln, start, end });
+
+                if (aJob->mReplaceAll) {
+                    replacedLine.append(line, copied, start - copied);
+                    replacedLine += it->format(aJob->mReplace);
+                    copied = end;
+                }
+            }
+        } else {
+            lineLower = line;
+            if (!aJob->mCaseSensitive)
+                std::transform(lineLower.begin(), lineLower.end(), lineLower.begin(), ::tolower);
+
+            size_t loc = lineLower.find(patternLower);
+            while (loc != std::string::npos) {
+                found.push_back({ ln, (int)loc, (int)(loc + patternLower.size()) });
+
+                if (aJob->mReplaceAll) {
+                    replacedLine.append(line, copied, loc - copied);
+                    replacedLine += aJob->mReplace;
+                    copied = loc + patternLower.size();
+                }
+
+                loc = lineLower.find(patternLower, loc + patternLower.size());
+            }
+        }
+
+        // replace-all keeps the text of every line between the first and the last match
+        if (aJob->mReplaceAll) {
+            if (found.size() > lineMatchStart) {
+                replacedLine.append(line, copied, std::string::npos);
+                if (replacedFirst == -1)
+                    replacedFirst = ln;
+                else {
+                    replaced += gap;
+                    replaced += '\n';
+                }
+                replaced += replacedLine;
+                replacedLast = ln;
+                gap.clear();
+            } else if (replacedFirst != -1) {
+                gap += '\n';
+                gap += line;
+            }
+        }
+
+        // stream the results found so far back to the UI thread
+        if (!aJob->mReplaceAll && (found.size() >= 256 || (ln % 4096) == 4095) && !found.empty()) {
+            std::lock_guard<std::mutex> lock(aJob->mMutex);
+            aJob->mPending.insert(aJob->mPending.end(), found.begin(), found.end());
+            found.clear();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(aJob->mMutex);
+    aJob->mPending.insert(aJob->mPending.end(), found.begin(), found.end());
+    aJob->mReplacedFirst = replacedFirst;
+    aJob->mReplacedLast = replacedLast;
+    aJob->mReplaced = std::move(replaced);
+    aJob->mDone = true;
+}
+
+void TextEditor::mUpdateSearch()
+{
+    if (mFindWord[0] == 0) {
+        mCancelSearch();
+        mSearchAction = SearchAction::None;
+        return;
+    }
+
+    bool replaceAll = mSearchAction == SearchAction::ReplaceAll;
+    auto job = mSearchJob;
+    if (job == nullptr || job->mPattern != mFindWord || job->mRegex != mFindRegex || job->mCaseSensitive != mFindCaseSensitive || job->mVersion != mTextVersion ||
+        job->mReplaceAll != replaceAll || (replaceAll && job->mReplace != mReplaceWord)) {
+        mStartSearch(replaceAll);
+        job = mSearchJob;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(job->mMutex);
+        mSearchResults.insert(mSearchResults.end(), job->mPending.begin(), job->mPending.end());
+        job->mPending.clear();
+        mSearchDone = job->mDone;
+    }
+
+    if (mSearchAction == SearchAction::ReplaceAll) {
+        if (!mSearchDone)
+            return;
+
+        mSearchAction = SearchAction::None;
+        if (job->mReplacedFirst == -1 || IsReadOnly())
+            return;
+
+        Coordinates start(job->mReplacedFirst, 0);
+        Coordinates end(job->mReplacedLast, GetLineMaxColumn(job->mReplacedLast));
+
+        UndoRecord u;
+        u.mBefore = mState;
+        u.mRemoved = GetText(start, end);
+        u.mRemovedStart = start;
+        u.mRemovedEnd = end;
+
+        SetSelection(start, end);
+        DeleteSelection();
+
+        u.mAdded = job->mReplaced;
+        u.mAddedStart = GetActualCursorCoordinates();
+
+        InsertTextInternal(job->mReplaced.c_str(), false);
+
+        u.mAddedEnd = GetActualCursorCoordinates();
+        u.mAfter = mState;
+        AddUndo(u);
+
+        mScrollToCursor = true;
+    } else if (mSearchAction != SearchAction::None && mResolveSearchAction())
+        mScrollToCursor = true;
+}
+
+bool TextEditor::mResolveSearchAction()
+{
+    auto job = mSearchJob;
+    if (job == nullptr || job->mReplaceAll)
+        return false;
+
+    // replace starts from the current selection so that the match selected by find is replaced
+    Coordinates anchor = mSearchAction == SearchAction::Replace ? mState.mSelectionStart : mState.mCursorPosition;
+    anchor = SanitizeCoordinates(anchor);
+    SearchMatch key = { anchor.mLine, GetCharacterIndex(anchor), 0 };
+
+    auto match = std::lower_bound(mSearchResults.begin(), mSearchResults.end(), key, [](const SearchMatch& a, const SearchMatch& b) {
+        return a.mLine < b.mLine || (a.mLine == b.mLine && a.mStart < b.mStart);
+    });
+    if (match == mSearchResults.end()) {
+        // wait for the worker before wrapping around
+        if (!mSearchDone)
+            return false;
+
+        match = mSearchResults.begin();
+        if (match == mSearchResults.end()) {
+            mSearchAction = SearchAction::None;
+            return false;
+        }
+    }
+
+    Coordinates start(match->mLine, GetCharacterColumn(match->mLine, match->mStart));
+    Coordinates end(match->mLine, GetCharacterColumn(match->mLine, match->mEnd));
+
+    if (mSearchAction == SearchAction::Find || IsReadOnly()) {
+        SetSelection(start, end);
+        SetCursorPosition(end);
+        mSearchAction = SearchAction::None;
+        return true;
+    }
+
+    std::string replacement = mReplaceWord;
+    if (job->mRegex) {
+        std::string line = job->mSnapshot->GetLineText(match->mLine);
+        auto flags = std::regex_constants::match_continuous;
+        if (match->mStart > 0)
+            flags |= std::regex_constants::match_prev_avail;
+
+        std::smatch m;
+        if (std::regex_search(line.cbegin() + match->mStart, line.cend(), m, job->mExpression, flags))
+            replacement = m.format(mReplaceWord);
+    }
+
+    UndoRecord u;
+    u.mBefore = mState;
+    u.mRemoved = GetText(start, end);
+    u.mRemovedStart = start;
+    u.mRemovedEnd = end;
+
+    SetSelection(start, end);
+    DeleteSelection();
+
+    u.mAdded = replacement;
+    u.mAddedStart = GetActualCursorCoordinates();
+
+    InsertTextInternal(replacement.c_str(), false);
+
+    u.mAddedEnd = GetActualCursorCoordinates();
+    u.mAfter = mState;
+    AddUndo(u);
+
+    // select the next match once the worker has searched the edited document
+    mSearchAction = SearchAction::Find;
+    return true;
+}
+
+void TextEditor::HandleKeyboardInputs()
+{
+    ImGuiIO& io = ImGui::GetIO();
+    auto shift = io.KeyShift;
+    auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
+    auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
+
+    if (ImGui::IsWindowFocused())
+    {
+        if (ImGui::IsWindowHovered())
+            ImGui::SetMouseCursor(ImGuiMouseCursor_TextInput);
+        //ImGui::CaptureKeyboardFromApp(true);
+
+        io.WantCaptureKeyboard = true;
         io.WantTextInput = true;
 
+        // the last available action among the shortcuts pressed this frame, in ShortcutID order
         ShortcutID actionID = ShortcutID::Count;
-        for (int i = 0; i < m_shortcuts.size(); i++) {
-            auto sct = m_shortcuts[i];
-
-            if (sct.Key1 == -1)
-                continue;
-                
-            ShortcutID curActionID = ShortcutID::Count;
+        for (ShortcutID curActionID : GetPressedShortcuts()) {
             bool additionalChecks = true;
-
-#           if IMGUICTE_USE_SDL2
-            SDL_Scancode sc1 = SDL_GetScancodeFromKey(sct.Key1);
-            if ((ImGui::IsKeyPressed(sc1) || (sc1 == SDL_SCANCODE_RETURN && ImGui::IsKeyPressed(SDL_SCANCODE_KP_ENTER))) && ((sct.Key2 != -1 && ImGui::IsKeyPressed(SDL_GetScancodeFromKey(sct.Key2))) || sct.Key2 == -1)) {
-                    if ((sct.Ctrl == ctrl) && (sct.Alt == alt) && (sct.Shift == shift)) {
-
-                            // PRESSED:
-                            curActionID = (ShortcutID)i;
-                            switch (curActionID) {
-                                    case ShortcutID::Paste:
-                                    case ShortcutID::Cut:
-                                    case ShortcutID::Redo:
-                                    case ShortcutID::Undo:
-                                    case ShortcutID::ForwardDelete:
-                                    case ShortcutID::BackwardDelete:
-                                    case ShortcutID::DeleteLeft:
-                                    case ShortcutID::DeleteRight:
-                                    case ShortcutID::ForwardDeleteWord:
-                                    case ShortcutID::BackwardDeleteWord:
-                                            additionalChecks = !IsReadOnly();
-                                    break;
-                                    case ShortcutID::MoveUp:
-                                    case ShortcutID::MoveDown:
-                                    case ShortcutID::SelectUp:
-                                    case ShortcutID::SelectDown:
-                                            additionalChecks = !mACOpened;
-                                    break;
-                                    case ShortcutID::AutocompleteUp:
-                                    case ShortcutID::AutocompleteDown:
-                                    case ShortcutID::AutocompleteSelect:
-                                            additionalChecks = mACOpened;
-                                    break;
-                                    case ShortcutID::AutocompleteSelectActive:
-                                            additionalChecks = mACOpened && mACSwitched;
-                                    break;
-                                    case ShortcutID::NewLine:
-                                    case ShortcutID::Indent:
-                                    case ShortcutID::Unindent:
-                                            additionalChecks = !IsReadOnly() && !mACOpened;
-                                    break;
-                                    default: break;
-                            }
-                    }
-            }
-
-#           else
-    
-            const ImGuiIO& io = ImGui::GetIO();
-            const bool ctrl  = (io.KeyMods & ImGuiMod_Ctrl)  != 0;
-            const bool alt   = (io.KeyMods & ImGuiMod_Alt)   != 0;
-            const bool shift = (io.KeyMods & ImGuiMod_Shift) != 0;
-
-            const ImGuiKey k1 = (ImGuiKey)sct.Key1;
-            const bool pressed1 = ImGui::IsKeyPressed(k1) ||
-                                  (k1 == ImGuiKey_Enter && ImGui::IsKeyPressed(ImGuiKey_KeypadEnter));
-            const bool pressed2 = (sct.Key2 != -1) ? ImGui::IsKeyPressed((ImGuiKey)sct.Key2) : true;
-
-            if (pressed1 && pressed2) {
-                    if (((sct.Ctrl == 0 && !ctrl) || (sct.Ctrl == 1 && ctrl) || (sct.Ctrl == 2)) &&
-                        ((sct.Alt  == 0 && !alt ) || (sct.Alt  == 1 && alt ) || (sct.Alt  == 2)) &&
-                        ((sct.Shift== 0 && !shift) || (sct.Shift== 1 && shift) || (sct.Shift== 2))) {
-
-                            // PRESSED:
-                            curActionID = (ShortcutID)i;
-                            switch (curActionID) {
-                                    case ShortcutID::Paste:
-                                    case ShortcutID::Cut:
-                                    case ShortcutID::Redo:
-                                    case ShortcutID::Undo:
-                                    case ShortcutID::ForwardDelete:
-                                    case ShortcutID::BackwardDelete:
-                                    case ShortcutID::DeleteLeft:
-                                    case ShortcutID::DeleteRight:
-                                    case ShortcutID::ForwardDeleteWord:
-                                    case ShortcutID::BackwardDeleteWord:
-                                            additionalChecks = !IsReadOnly();
-                                    break;
-                                    case ShortcutID::MoveUp:
-                                    case ShortcutID::MoveDown:
-                                    case ShortcutID::SelectUp:
-                                    case ShortcutID::SelectDown:
-                                            additionalChecks = !mACOpened;
-                                    break;
-                                    case ShortcutID::AutocompleteUp:
-                                    case ShortcutID::AutocompleteDown:
-                                    case ShortcutID::AutocompleteSelect:
-                                            additionalChecks = mACOpened;
-                                    break;
-                                    case ShortcutID::AutocompleteSelectActive:
-                                            additionalChecks = mACOpened && mACSwitched;
-                                    break;
-                                    case ShortcutID::NewLine:
-                                    case ShortcutID::Indent:
-                                    case ShortcutID::Unindent:
-                                            additionalChecks = !IsReadOnly() && !mACOpened;
-                                    break;
-                                    default: break;
-                            }
-                    }
-            }
-
-#           endif
+            switch (curActionID) {
+                case ShortcutID::Paste:
+                case ShortcutID::Cut:
+                case ShortcutID::Redo:
+                case ShortcutID::Undo:
+                case ShortcutID::ForwardDelete:
+                case ShortcutID::BackwardDelete:
+                case ShortcutID::DeleteLeft:
+                case ShortcutID::DeleteRight:
+                case ShortcutID::ForwardDeleteWord:
+                case ShortcutID::BackwardDeleteWord:
+                    additionalChecks = !IsReadOnly();
+                break;
+                case ShortcutID::MoveUp:
+                case ShortcutID::MoveDown:
+                case ShortcutID::SelectUp:
+                case ShortcutID::SelectDown:
+                    additionalChecks = !mACOpened;
+                break;
+                case ShortcutID::AutocompleteUp:
+                case ShortcutID::AutocompleteDown:
+                case ShortcutID::AutocompleteSelect:
+                    additionalChecks = mACOpened;
+                break;
+                case ShortcutID::AutocompleteSelectActive:
+                    additionalChecks = mACOpened && mACSwitched;
+                break;
+                case ShortcutID::NewLine:
+                case ShortcutID::Indent:
+                case ShortcutID::Unindent:
+                    additionalChecks = !IsReadOnly() && !mACOpened;
+                break;
+                default: break;
+            }
 
-            if (additionalChecks && curActionID != ShortcutID::Count)
+            if (additionalChecks)
                 actionID = curActionID;
         }
 
@@ -1493,6 +2307,7 @@ void TextEditor::HandleKeyboardInputs()
                     undo.mBefore = mState;
 
                     auto oldLine = mLines[mState.mCursorPosition.mLine];
+                    BeginViewRemap();
                     auto& line = InsertLine(mState.mCursorPosition.mLine, mState.mCursorPosition.mColumn);
 
                     undo.mAdded += '\n';
@@ -1508,25 +2323,44 @@ void TextEditor::HandleKeyboardInputs()
                     undo.mAfter = mState;
 
                     AddUndo(undo);
+
+                    MarkTextChanged();
+                    if (WantsTextChanges())
+                        AddTextChange(Coordinates(undo.mAddedStart.mLine, 0), Coordinates(undo.mAddedStart.mLine, 0), undo.mAdded.substr(1) + '\n');
                 } break;
                 case ShortcutID::CommentLines: {
+                    MarkTextChanged();
                     for (int l = mState.mSelectionStart.mLine; l <= mState.mSelectionEnd.mLine && l < mLines.size(); l++) {
+                        BeginViewRemap();
                         mLines[l].insert(mLines[l].begin(), TextEditor::Glyph('/', PaletteIndex::Comment));
                         mLines[l].insert(mLines[l].begin(), TextEditor::Glyph('/', PaletteIndex::Comment));
+                        InvalidateSnapshotLines(l, l + 1);
+                        AddTextChange(Coordinates(l, 0), Coordinates(l, 0), "//");
                     }
-                    Colorize(mState.mSelectionStart.mLine, mState.mSelectionEnd.mLine);
+                    Colorize(mState.mSelectionStart.mLine, mState.mSelectionEnd.mLine - mState.mSelectionStart.mLine + 1);
                 } break;
                 case ShortcutID::UncommentLines: {
+                    MarkTextChanged();
                     for (int l = mState.mSelectionStart.mLine; l <= mState.mSelectionEnd.mLine && l < mLines.size(); l++) {
                         if (mLines[l].size() >= 2) {
-                            if (mLines[l][0].mChar == '/' && mLines[l][1].mChar == '/')
+                            if (mLines[l][0].mChar == '/' && mLines[l][1].mChar == '/') {
+                                BeginViewRemap();
                                 mLines[l].erase(mLines[l].begin(), mLines[l].begin() + 2);
+                                InvalidateSnapshotLines(l, l + 1);
+                                AddTextChange(Coordinates(l, 0), Coordinates(l, 2), std::string());
+                            }
                         }
                     }
-                    Colorize(mState.mSelectionStart.mLine, mState.mSelectionEnd.mLine);
+                    Colorize(mState.mSelectionStart.mLine, mState.mSelectionEnd.mLine - mState.mSelectionStart.mLine + 1);
                 } break;
             }
         } else if (!IsReadOnly()) {
+            // a burst of characters (key repeat, IME commit, input lag) is one edit: a single undo step,
+            // fold/marker pass and colorization
+            bool batch = io.InputQueueCharacters.Size > 1;
+            if (batch)
+                BeginEdit();
+
             for (int i = 0; i < io.InputQueueCharacters.Size; i++)
             {
                 auto c = (unsigned char)io.InputQueueCharacters[i];
@@ -1559,7 +2393,7 @@ void TextEditor::HandleKeyboardInputs()
                                 if (j != mSnippetTagSelected) {
                                     SetSelection(mSnippetTagStart[j], mSnippetTagEnd[j]);
                                     Backspace();
-                                    InsertText(curWord);
+                                    InsertTextInternal(curWord.c_str(), false);
                                     mSnippetTagEnd[j].mColumn = mSnippetTagStart[j].mColumn + mSnippetTagLength;
                                 }
                             }
@@ -1574,6 +2408,9 @@ void TextEditor::HandleKeyboardInputs()
                 }
             }
             io.InputQueueCharacters.resize(0);
+
+            if (batch)
+                EndEdit();
         }
 
         // active autocomplete
@@ -1584,17 +2421,24 @@ void TextEditor::HandleKeyboardInputs()
         }
 
         if ((mACOpened && !keepACOpened) || mFunctionDeclarationTooltip) {
-            for (size_t i = 0; i < ImGuiKey_COUNT; i++)
-                keyCount += ImGui::IsKeyPressed((ImGuiKey)i);
+            // any key that went down this frame closes the popup
+            for (auto& event : ImGui::GetCurrentContext()->InputEventsTrail)
+                keyCount += event.Type == ImGuiInputEventType_Key && event.Key.Down;
 
             if (keyCount != 0) {
                 if (functionTooltipState == mFunctionDeclarationTooltip)
                     mFunctionDeclarationTooltip = false;
                 mACOpened = false;
-                if (!hasWrittenALetter)
+                if (!hasWrittenALetter) {
                     mACObject = "";
+                    mCancelACProvider();
+                }
             }
         }
+
+        // dismiss a provider request that has not shown its results yet
+        if (mACProviderJob != nullptr && ImGui::IsKeyPressed(ImGuiKey_Escape))
+            mCancelACProvider();
     }
 }
 
@@ -1672,6 +2516,7 @@ void TextEditor::HandleMouseInputs()
                 else {
                     mACOpened = false;
                     mACObject = "";
+                    mCancelACProvider();
 
                     auto tcoords = ScreenPosToCoordinates(ImGui::GetMousePos());
                     
@@ -1707,12 +2552,15 @@ void TextEditor::HandleMouseInputs()
     }
 }
 
+int TextEditor::FindBreakpoint(int aLine) const
+{
+    auto it = std::lower_bound(mBreakpoints.begin(), mBreakpoints.end(), aLine, BreakpointBefore);
+    return it != mBreakpoints.end() && it->mLine == aLine ? (int)(it - mBreakpoints.begin()) : -1;
+}
+
 bool TextEditor::HasBreakpoint(int line)
 {
-    for (const auto& bkpt : mBreakpoints)
-        if (bkpt.mLine == line)
-            return true;
-    return false;
+    return FindBreakpoint(line) >= 0;
 }
 void TextEditor::AddBreakpoint(int line, bool useCondition, std::string condition, bool enabled)
 {
@@ -1727,37 +2575,111 @@ void TextEditor::AddBreakpoint(int line, bool useCondition, std::string conditio
     if (OnBreakpointUpdate)
         OnBreakpointUpdate(this, line, useCondition, condition, enabled);
 
-    mBreakpoints.push_back(bkpt);
+    mBreakpoints.insert(std::lower_bound(mBreakpoints.begin(), mBreakpoints.end(), line, BreakpointBefore), std::move(bkpt));
 }
 void TextEditor::RemoveBreakpoint(int line)
 {
-    for (int i = 0; i < mBreakpoints.size(); i++)
-        if (mBreakpoints[i].mLine == line) {
-            mBreakpoints.erase(mBreakpoints.begin() + i);
-            break;
-        }
+    int index = FindBreakpoint(line);
+    if (index >= 0)
+        mBreakpoints.erase(mBreakpoints.begin() + index);
+    if (mEditDepth > 0)
+        mEditRemovedBreakpoints.push_back(line); // the breakpoints set aside by BeginEdit() are dropped in EndEdit()
     if (OnBreakpointRemove)
         OnBreakpointRemove(this, line);
 }
 void TextEditor::SetBreakpointEnabled(int line, bool enable)
 {
-    for (int i = 0; i < mBreakpoints.size(); i++)
-        if (mBreakpoints[i].mLine == line) {
-            mBreakpoints[i].mEnabled = enable;
-            if (OnBreakpointUpdate)
-                OnBreakpointUpdate(this, line, mBreakpoints[i].mUseCondition, mBreakpoints[i].mCondition, enable);
-            break;
-        }
+    int index = FindBreakpoint(line);
+    if (index >= 0) {
+        mBreakpoints[index].mEnabled = enable;
+        if (OnBreakpointUpdate)
+            OnBreakpointUpdate(this, line, mBreakpoints[index].mUseCondition, mBreakpoints[index].mCondition, enable);
+    }
 }
 TextEditor::Breakpoint& TextEditor::GetBreakpoint(int line)
 {
-    for (int i = 0; i < mBreakpoints.size(); i++)
-        if (mBreakpoints[i].mLine == line)
-            return mBreakpoints[i];
-    static TextEditor::Breakpoint dummy{};
+    int index = FindBreakpoint(line);
+    if (index >= 0)
+        return mBreakpoints[index];
+    static TextEditor::Breakpoint dummy{};
     return dummy;
 }
 
+std::string TextEditor::GetHoverExpression(const Coordinates& aPosition, Char aHoverChar) const
+{
+    std::string expr;
+
+    int colStart = 0, rowStart = aPosition.mLine;
+    int bracketMatch = 0;
+    if (aHoverChar == ')') {
+        // collected backwards, reversed once at the end
+        int colIndex = aPosition.mColumn;
+        for (; rowStart >= 0; rowStart--) {
+            for (int i = colIndex; i >= 0; i--) {
+                char curChar = mLines[rowStart][i].mChar;
+                if (curChar == '(')
+                    bracketMatch++;
+                else if (curChar == ')')
+                    bracketMatch--;
+
+                if (!isspace(curChar) || curChar == ' ')
+                    expr += curChar;
+
+                if (bracketMatch == 0) {
+                    colStart = i - 1;
+                    break;
+                }
+            }
+            if (bracketMatch == 0)
+                break;
+            if (rowStart != 0)
+                colIndex = mLines[rowStart - 1].size() - 1;
+        }
+        std::reverse(expr.begin(), expr.end());
+
+        if (rowStart <= 0)
+            colStart = -1;
+    } else if (aHoverChar == '(') {
+        int colIndex = aPosition.mColumn;
+        colStart = aPosition.mColumn - 1;
+        for (int j = rowStart; j < mLines.size(); j++) {
+            for (int i = colIndex; i < mLines[j].size(); i++) {
+                char curChar = mLines[j][i].mChar;
+                if (curChar == '(')
+                    bracketMatch++;
+                else if (curChar == ')')
+                    bracketMatch--;
+
+                if (!isspace(curChar) || curChar == ' ')
+                    expr += curChar;
+
+                if (bracketMatch == 0)
+                    break;
+            }
+
+            if (bracketMatch == 0)
+                break;
+            if (j != 0)
+                colIndex = 0;
+        }
+
+        if (rowStart >= mLines.size())
+            colStart = -1;
+    }
+
+    // the function name in front of the parenthesis
+    int nameStart = colStart;
+    while (nameStart >= 0 && isalnum(mLines[rowStart][nameStart].mChar))
+        nameStart--;
+    if (nameStart < colStart) {
+        std::string name;
+        for (int i = nameStart + 1; i <= colStart; i++)
+            name += mLines[rowStart][i].mChar;
+        expr.insert(0, name);
+    }
+    return expr;
+}
+
 void TextEditor::RenderInternal(const char* aTitle)
 {
     /* Compute mCharAdvance regarding to scaled font size (Ctrl + mouse wheel)*/
@@ -1788,6 +2710,7 @@ void TextEditor::RenderInternal(const char* aTitle)
     ImVec2 cursorScreenPos = mUICursorPos = ImGui::GetCursorScreenPos();
     auto scrollX = ImGui::GetScrollX();
     auto scrollY = mLastScroll = ImGui::GetScrollY();
+    mPinnedToBottom = scrollY >= ImGui::GetScrollMaxY() - 1.0f;
 
     int pageSize = (int)floor((scrollY + contentSize.y) / mCharAdvance.y);
     auto lineNo = (int)floor(scrollY / mCharAdvance.y);
@@ -1957,6 +2880,7 @@ void TextEditor::RenderInternal(const char* aTitle)
         }
 
         // render
+        size_t bkptIndex = std::lower_bound(mBreakpoints.begin(), mBreakpoints.end(), lineNo + 1, BreakpointBefore) - mBreakpoints.begin();
         while (lineNo <= lineMax)
         {
             ImVec2 lineStartScreenPos = ImVec2(cursorScreenPos.x, cursorScreenPos.y + (lineNo - linesFolded) * mCharAdvance.y);
@@ -2219,8 +3143,10 @@ void TextEditor::RenderInternal(const char* aTitle)
             if (mSidebar) {
                 drawList->AddRectFilled(ImVec2(lineStartScreenPos.x + scrollX, lineStartScreenPos.y), ImVec2(lineStartScreenPos.x + scrollX + mTextStart - 5.0f, lineStartScreenPos.y + mCharAdvance.y), ImGui::GetColorU32(ImGuiCol_WindowBg));
 
-                // Draw breakpoints
-                if (HasBreakpoint(lineNo + 1) != 0) {
+                // Draw breakpoints, the visible lines increase so the next one is found by advancing
+                while (bkptIndex < mBreakpoints.size() && mBreakpoints[bkptIndex].mLine < lineNo + 1)
+                    bkptIndex++;
+                if (bkptIndex < mBreakpoints.size() && mBreakpoints[bkptIndex].mLine == lineNo + 1) {
                     float radius = ImGui::GetFontSize() * 1.0f / 3.0f;
                     float startX = lineStartScreenPos.x + scrollX + radius + 2.0f;
                     float startY = lineStartScreenPos.y + radius + 4.0f;
@@ -2228,7 +3154,7 @@ void TextEditor::RenderInternal(const char* aTitle)
                     drawList->AddCircle(ImVec2(startX, startY), radius + 1, mPalette[(int)PaletteIndex::BreakpointOutline]);
                     drawList->AddCircleFilled(ImVec2(startX, startY), radius, mPalette[(int)PaletteIndex::Breakpoint]);
 
-                    Breakpoint bkpt = GetBreakpoint(lineNo + 1);
+                    const Breakpoint& bkpt = mBreakpoints[bkptIndex];
                     if (!bkpt.mEnabled)
                         drawList->AddCircleFilled(ImVec2(startX, startY), radius - 1, mPalette[(int)PaletteIndex::BreakpointDisabled]);
                     else {
@@ -2396,94 +3322,58 @@ void TextEditor::RenderInternal(const char* aTitle)
         // Draw a tooltip on known identifiers/preprocessor symbols
         if (ImGui::IsMousePosValid() && (IsDebugging() || mFuncTooltips || ImGui::GetIO().KeyCtrl))
         {
-            Coordinates hoverPosition = MousePosToCoordinates(ImGui::GetMousePos());
-            if (hoverPosition != mLastHoverPosition) {
-                mLastHoverPosition = hoverPosition;
-                mLastHoverTime = std::chrono::steady_clock::now();
+            // the target under the mouse is resolved once per position, text version and debugger step
+            ImVec2 mousePos = ImGui::GetMousePos();
+            if (mousePos.x != mHover.mMousePos.x || mousePos.y != mHover.mMousePos.y || mUICursorPos.x != mHover.mOrigin.x || mUICursorPos.y != mHover.mOrigin.y ||
+                mCharAdvance.x != mHover.mCharAdvance.x || mCharAdvance.y != mHover.mCharAdvance.y || ImGui::IsMouseClicked(ImGuiMouseButton_Left) ||
+                mHover.mTextVersion != mTextVersion || mHover.mDebugLine != mDebugCurrentLine) {
+                Coordinates hoverPosition = MousePosToCoordinates(mousePos);
+                Coordinates wordPosition = ScreenPosToCoordinates(mousePos);
+                if (mHover.mTime == std::chrono::steady_clock::time_point() || hoverPosition != mHover.mPosition || wordPosition != mHover.mWordPosition || mHover.mTextVersion != mTextVersion || mHover.mDebugLine != mDebugCurrentLine) {
+                    mHover = HoverCache();
+                    mHover.mPosition = hoverPosition;
+                    mHover.mWordPosition = wordPosition;
+                    mHover.mTime = std::chrono::steady_clock::now();
+                }
+                mHover.mMousePos = mousePos;
+                mHover.mOrigin = mUICursorPos;
+                mHover.mCharAdvance = mCharAdvance;
+                mHover.mTextVersion = mTextVersion;
+                mHover.mDebugLine = mDebugCurrentLine;
             }
-            
+            const Coordinates& hoverPosition = mHover.mPosition;
+
             Char hoverChar = 0;
             if (hoverPosition.mLine < mLines.size() && hoverPosition.mColumn < mLines[hoverPosition.mLine].size())
                 hoverChar = mLines[hoverPosition.mLine][hoverPosition.mColumn].mChar;
 
-            double hoverTime = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - mLastHoverTime).count();
-            
-            if (hoverTime > 0.5 && (hoverChar == '(' || hoverChar == ')') && IsDebugging()) {
-                std::string expr = "";
-
-                int colStart = 0, rowStart = hoverPosition.mLine;
-                int bracketMatch = 0;
-                if (hoverChar == ')') {
-                    int colIndex = hoverPosition.mColumn;
-                    for (; rowStart >= 0; rowStart--) {
-                        for (int i = colIndex; i >= 0; i--) {
-                            char curChar = mLines[rowStart][i].mChar;
-                            if (curChar == '(')
-                                bracketMatch++;
-                            else if (curChar == ')')
-                                bracketMatch--;
-
-                            if (!isspace(curChar) || curChar == ' ')
-                                expr += curChar;
-
-                            if (bracketMatch == 0) {
-                                colStart = i - 1;
-                                break;
-                            }
-                        }
-                        if (bracketMatch == 0)
-                            break;
-                        if (rowStart != 0)
-                            colIndex = mLines[rowStart - 1].size() - 1;
-                    }
-                    std::reverse(expr.begin(), expr.end());
-
-                    if (rowStart <= 0)
-                        colStart = -1;
-                } else if (hoverChar == '(') {
-                    int colIndex = hoverPosition.mColumn;
-                    colStart = hoverPosition.mColumn - 1;
-                    for (int j = rowStart; j < mLines.size(); j++) {
-                        for (int i = colIndex; i < mLines[j].size(); i++) {
-                            char curChar = mLines[j][i].mChar;
-                            if (curChar == '(')
-                                bracketMatch++;
-                            else if (curChar == ')')
-                                bracketMatch--;
-
-                            if (!isspace(curChar) || curChar == ' ')
-                                expr += curChar;
-
-                            if (bracketMatch == 0)
-                                break;
-                        }
-
-                        if (bracketMatch == 0)
-                            break;
-                        if (j != 0)
-                            colIndex = 0;
-                    }
-
-                    if (rowStart >= mLines.size())
-                        colStart = -1;
-                }
+            double hoverTime = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - mHover.mTime).count();
 
-                while (colStart >= 0 && isalnum(mLines[rowStart][colStart].mChar)) {
-                    expr.insert(expr.begin(), mLines[rowStart][colStart].mChar);
-                    colStart--;
+            if (hoverTime > 0.5 && (hoverChar == '(' || hoverChar == ')') && IsDebugging()) {
+                if (!mHover.mExpressionResolved) {
+                    mHover.mExpression = GetHoverExpression(hoverPosition, hoverChar);
+                    mHover.mExpressionResolved = true;
                 }
 
+                // the debugger is asked once per hover, the tooltip is drawn every frame
                 if (OnExpressionHover && HasExpressionHover)
                 {
-                    if (HasExpressionHover(this, expr)) {
+                    if (mHover.mExpressionHover < 0)
+                        mHover.mExpressionHover = HasExpressionHover(this, mHover.mExpression);
+                    if (mHover.mExpressionHover > 0) {
                         ImGui::BeginTooltip();
-                        OnExpressionHover(this, expr);
+                        OnExpressionHover(this, mHover.mExpression);
                         ImGui::EndTooltip();
-                    }               }
+                    }
+                }
             }
             else if (hoverTime > 0.2) {
-                Coordinates wordCoords = ScreenPosToCoordinates(ImGui::GetMousePos());
-                auto id = GetWordAt(wordCoords);
+                const Coordinates& wordCoords = mHover.mWordPosition;
+                if (!mHover.mWordResolved) {
+                    mHover.mWord = GetWordAt(wordCoords);
+                    mHover.mWordResolved = true;
+                }
+                const std::string& id = mHover.mWord;
                 bool isCtrlDown = ImGui::GetIO().KeyCtrl;
 
                 if (!id.empty()) {
@@ -2501,7 +3391,9 @@ void TextEditor::RenderInternal(const char* aTitle)
                                 ImGui::TextUnformatted(pi->second.mDeclaration.c_str());
                                 ImGui::EndTooltip();
                             } else if (IsDebugging() && OnIdentifierHover && HasIdentifierHover) {
-                                if (HasIdentifierHover(this, id)) {
+                                if (mHover.mIdentifierHover < 0)
+                                    mHover.mIdentifierHover = HasIdentifierHover(this, id);
+                                if (mHover.mIdentifierHover > 0) {
                                     ImGui::BeginTooltip();
                                     OnIdentifierHover(this, id);
                                     ImGui::EndTooltip();
@@ -2701,11 +3593,20 @@ void TextEditor::RenderInternal(const char* aTitle)
         ImGui::SetNextWindowPos(acPos, ImGuiCond_Always);
         ImGui::BeginChild("##texteditor_autocompl", ImVec2(mUICalculateSize(150), mUICalculateSize(100)), true);
         
-        for (int i = 0; i < mACSuggestions.size(); i++) {
-            ImGui::Selectable(mACSuggestions[i].first.c_str(), i == mACIndex);
-            if (i == mACIndex)
-                ImGui::SetScrollHereY();
+        // keep the selected entry centered, only the visible entries are submitted
+        const float itemHeight = ImGui::GetTextLineHeightWithSpacing();
+        ImGui::SetScrollY(std::max<float>(0.0f, mACIndex * itemHeight - (ImGui::GetWindowHeight() - itemHeight) * 0.5f));
+
+        ImGuiListClipper clipper;
+        clipper.Begin((int)mACSuggestions.size(), itemHeight);
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                ImGui::PushID(i);
+                ImGui::Selectable(mACSuggestions[i].first.c_str(), i == mACIndex);
+                ImGui::PopID();
+            }
         }
+        clipper.End();
 
         ImGui::EndChild();
 
@@ -2715,11 +3616,18 @@ void TextEditor::RenderInternal(const char* aTitle)
         if (ImGui::IsKeyPressed(ImGuiKey_Escape)) {
             mACOpened = false;
             mACObject = "";
+            mCancelACProvider();
         }
     }
 
     ImGui::Dummy(ImVec2(longest + mEditorCalculateSize(100), (mLines.size() - totalLinesFolded) * mCharAdvance.y));
 
+    if (mScrollToBottom)
+    {
+        mScrollToBottom = false;
+        ImGui::SetScrollHereY(1.0f);
+    }
+
     if (mDebugCurrentLineUpdated) {
         float scrollX = ImGui::GetScrollX();
         float scrollY = ImGui::GetScrollY();
@@ -3061,7 +3969,7 @@ void TextEditor::mAutocompleteSelect()
         SetSelection(acStart, acEnd);
         Backspace();
     }
-    InsertText(entryText, true);
+    InsertTextInternal(entryText.c_str(), true);
 
     undo.mAdded = entryText;
     undo.mAddedEnd = GetActualCursorCoordinates();
@@ -3077,6 +3985,7 @@ void TextEditor::mAutocompleteSelect()
     m_requestAutocomplete = false;
     mACOpened = false;
     mACObject = "";
+    mCancelACProvider();
     
     undo.mAfter = mState;
 
@@ -3167,7 +4076,96 @@ void TextEditor::m_buildMemberSuggestions(bool* keepACOpened)
 #endif
 }
 // AUTOCOMPLETE SUGGESTIONS
+static uint64_t ACCharacterMask(const std::string& aKey)
+{
+        uint64_t mask = 0;
+        for (char c : aKey) {
+                if (c >= 'a' && c <= 'z')
+                        mask |= 1ull << (c - 'a');
+                else if (c >= '0' && c <= '9')
+                        mask |= 1ull << (26 + c - '0');
+                else if (c == '_')
+                        mask |= 1ull << 36;
+                else
+                        mask |= 1ull << 37;
+        }
+        return mask;
+}
+
+// subsequence match of a lowercase query, consecutive characters and word starts score higher; -1 if no match
+static int ACFuzzyScore(const std::string& aKey, const std::string& aQuery)
+{
+        int score = 0, previous = -2, first = -1;
+        size_t q = 0;
+        for (size_t i = 0; i < aKey.size() && q < aQuery.size(); i++) {
+                if (aKey[i] != aQuery[q])
+                        continue;
+
+                score += 1;
+                if ((int)i == previous + 1)
+                        score += 5;
+                if (i == 0 || !isalnum((unsigned char)aKey[i - 1]))
+                        score += 3;
+                if (first < 0)
+                        first = (int)i;
+                previous = (int)i;
+                q++;
+        }
+        if (q < aQuery.size())
+                return -1;
+
+        // prefixes always rank first
+        if (first == 0 && previous == (int)aQuery.size() - 1)
+                score += 1000;
+        return score - first;
+}
+
+TextEditor::ACCandidate TextEditor::mMakeACCandidate(const std::string& aSearch, const std::string& aDisplay, const std::string& aValue, bool aCall, bool aCustom)
+{
+        ACCandidate candidate;
+        candidate.mKey = aSearch;
+        std::transform(candidate.mKey.begin(), candidate.mKey.end(), candidate.mKey.begin(), tolower);
+        candidate.mMask = ACCharacterMask(candidate.mKey);
+        candidate.mDisplay = aDisplay;
+        candidate.mValue = aValue;
+        candidate.mCall = aCall;
+        candidate.mCustom = aCustom;
+        return candidate;
+}
+
+void TextEditor::AddAutocompleteEntry(const std::string& search, const std::string& display, const std::string& value)
+{
+        mACCandidates.push_back(mMakeACCandidate(search, display, value, false, true));
+}
+
+void TextEditor::ClearAutocompleteEntries()
+{
+        mACCandidates.erase(std::remove_if(mACCandidates.begin(), mACCandidates.end(), [](const ACCandidate& a) { return a.mCustom; }), mACCandidates.end());
+}
+
+void TextEditor::mBuildACCandidates()
+{
+        // custom entries are added incrementally, everything else is rebuilt from its source
+        mACCandidates.erase(std::remove_if(mACCandidates.begin(), mACCandidates.end(), [](const ACCandidate& a) { return !a.mCustom; }), mACCandidates.end());
+
 #if IMGUICTE_ENABLE_SPIRV
+        for (auto& func : mACFunctions)
+                mACCandidates.push_back(mMakeACCandidate(func.first, func.first, func.first, true, false));
+        for (auto& uni : mACUniforms)
+                mACCandidates.push_back(mMakeACCandidate(uni.Name, uni.Name, uni.Name, false, false));
+        for (auto& glob : mACGlobals)
+                mACCandidates.push_back(mMakeACCandidate(glob.Name, glob.Name, glob.Name, false, false));
+        for (auto& utype : mACUserTypes)
+                mACCandidates.push_back(mMakeACCandidate(utype.first, utype.first, utype.first, false, false));
+#endif
+        for (auto& str : mLanguageDefinition.mKeywords)
+                mACCandidates.push_back(mMakeACCandidate(str, str, str, false, false));
+        for (auto& str : mLanguageDefinition.mIdentifiers)
+                mACCandidates.push_back(mMakeACCandidate(str.first, str.first, str.first, true, false));
+
+        mACCandidatesDirty = false;
+}
+
 void TextEditor::m_buildSuggestions(bool* keepACOpened)
 {
         mACWord = GetWordUnderCursor();
@@ -3186,152 +4184,188 @@ void TextEditor::m_buildSuggestions(bool* keepACOpened)
 
                 std::string acWord = mACWord;
                 std::transform(acWord.begin(), acWord.end(), acWord.begin(), tolower);
+                uint64_t acMask = ACCharacterMask(acWord);
 
-                struct ACEntry {
-                        ACEntry(const std::string& str, const std::string& val, int loc)
-                        {
-                                DisplayString = str;
-                                Value = val;
-                                Location = loc;
-                        }
-
-                        std::string DisplayString;
-                        std::string Value;
-                        int Location;
+                struct ACMatch {
+                        int Score;
+                        size_t Order;
+                        const ACCandidate* Candidate;
+                };
+                std::vector<ACMatch> matches;
+                std::vector<ACCandidate> scoped; // locals, arguments and members depend on the cursor
+                auto consider = [&](const ACCandidate& candidate) {
+                        if ((acMask & ~candidate.mMask) != 0)
+                                return;
+                        int score = ACFuzzyScore(candidate.mKey, acWord);
+                        if (score >= 0)
+                                matches.push_back({ score, matches.size(), &candidate });
                 };
-                std::vector<ACEntry> weights;
 
                 if (mACObject.empty()) {
-                        // get the words
-                        for (int i = 0; i < mACEntrySearch.size(); i++) {
-                                std::string lwrStr = mACEntrySearch[i];
-                                std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
-
-                                size_t loc = lwrStr.find(acWord);
-                                if (loc != std::string::npos)
-                                        weights.push_back(ACEntry(mACEntries[i].first, mACEntries[i].second, loc));
-                        }
+#if IMGUICTE_ENABLE_SPIRV
                         for (auto& func : mACFunctions) {
-                                std::string lwrStr = func.first;
-                                std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
-
                                 // suggest arguments and locals
                                 if (mState.mCursorPosition.mLine >= func.second.LineStart - 2 && mState.mCursorPosition.mLine <= func.second.LineEnd + 1) {
-
-                                        // locals
-                                        for (auto& loc : func.second.Locals) {
-                                                std::string lwrLoc = loc.Name;
-                                                std::transform(lwrLoc.begin(), lwrLoc.end(), lwrLoc.begin(), tolower);
-
-                                                size_t location = lwrLoc.find(acWord);
-                                                if (location != std::string::npos)
-                                                        weights.push_back(ACEntry(loc.Name, loc.Name, location));
-                                        }
-
-                                        // arguments
-                                        for (auto& arg : func.second.Arguments) {
-                                                std::string lwrLoc = arg.Name;
-                                                std::transform(lwrLoc.begin(), lwrLoc.end(), lwrLoc.begin(), tolower);
-
-                                                size_t loc = lwrLoc.find(acWord);
-                                                if (loc != std::string::npos)
-                                                        weights.push_back(ACEntry(arg.Name, arg.Name, loc));
-                                        }
-                                }
-
-                                size_t loc = lwrStr.find(acWord);
-                                if (loc != std::string::npos) {
-                                        std::string val = func.first;
-                                        if (mCompleteBraces) val += "()";
-                                        weights.push_back(ACEntry(func.first, val, loc));
+                                        for (auto& loc : func.second.Locals)
+                                                scoped.push_back(mMakeACCandidate(loc.Name, loc.Name, loc.Name, false, false));
+                                        for (auto& arg : func.second.Arguments)
+                                                scoped.push_back(mMakeACCandidate(arg.Name, arg.Name, arg.Name, false, false));
                                 }
                         }
-                        for (auto& uni : mACUniforms) {
-                                std::string lwrStr = uni.Name;
-                                std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
+#endif
+                        for (auto& candidate : scoped)
+                                consider(candidate);
+
+                        if (mACCandidatesDirty)
+                                mBuildACCandidates();
+                        for (auto& candidate : mACCandidates)
+                                consider(candidate);
+
+                        // identifiers found in the document, except the word being typed
+                        for (auto& word : mDocument->mWords)
+                                if (word.mRefs > 0 && word.mCandidate.mDisplay != mACWord)
+                                        consider(word.mCandidate);
+                }
+                else {
+#if IMGUICTE_ENABLE_SPIRV
+                        for (const auto& uType : mACUserTypes)
+                                if (uType.first == mACObject)
+                                        for (const auto& uMember : uType.second)
+                                                scoped.push_back(mMakeACCandidate(uMember.Name, uMember.Name, uMember.Name, false, false));
+#endif
+                        for (auto& candidate : scoped)
+                                consider(candidate);
+                }
 
-                                size_t loc = lwrStr.find(acWord);
-                                if (loc != std::string::npos)
-                                        weights.push_back(ACEntry(uni.Name, uni.Name, loc));
-                        }
-                        for (auto& glob : mACGlobals) {
-                                std::string lwrStr = glob.Name;
-                                std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
+                // only the best ranked matches are listed
+                size_t count = std::min<size_t>(matches.size(), ACMaxSuggestions);
+                std::partial_sort(matches.begin(), matches.begin() + count, matches.end(), [](const ACMatch& a, const ACMatch& b) {
+                        if (a.Score != b.Score)
+                                return a.Score > b.Score;
+                        if (a.Candidate->mKey.size() != b.Candidate->mKey.size())
+                                return a.Candidate->mKey.size() < b.Candidate->mKey.size();
+                        return a.Order < b.Order;
+                });
+                std::unordered_set<std::string> listed; // a word of the document can also be a custom entry
+                for (size_t i = 0; i < count; i++) {
+                        auto& candidate = *matches[i].Candidate;
+                        if (!listed.insert(candidate.mDisplay).second)
+                                continue;
+                        mACSuggestions.push_back(std::make_pair(candidate.mDisplay, candidate.mCall && mCompleteBraces ? candidate.mValue + "()" : candidate.mValue));
+                }
 
-                                size_t loc = lwrStr.find(acWord);
-                                if (loc != std::string::npos)
-                                        weights.push_back(ACEntry(glob.Name, glob.Name, loc));
-                        }
-                        for (auto& utype : mACUserTypes) {
-                                std::string lwrStr = utype.first;
-                                std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
+                if (mACSuggestions.size() > 0) {
+                        mACOpened = true;
 
-                                size_t loc = lwrStr.find(acWord);
-                                if (loc != std::string::npos)
-                                        weights.push_back(ACEntry(utype.first, utype.first, loc));
-                        }
-                        for (auto& str : mLanguageDefinition.mKeywords) {
-                                std::string lwrStr = str;
-                                std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
+                        if (keepACOpened != nullptr)
+                                *keepACOpened = true;
 
-                                size_t loc = lwrStr.find(acWord);
-                                if (loc != std::string::npos)
-                                        weights.push_back(ACEntry(str, str, loc));
-                        }
-                        for (auto& str : mLanguageDefinition.mIdentifiers) {
-                                std::string lwrStr = str.first;
-                                std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
-
-                                size_t loc = lwrStr.find(acWord);
-                                if (loc != std::string::npos) {
-                                        std::string val = str.first;
-                                        if (mCompleteBraces) val += "()";
-                                        weights.push_back(ACEntry(str.first, val, loc));
-                                }
-                        }
+                        Coordinates curCursor = GetCursorPosition();
+                        curCursor.mColumn--;
+
+                        mACPosition = FindWordStart(curCursor);
                 }
-                else {
-                        for (const auto& uType : mACUserTypes) {
-                                if (uType.first == mACObject) {
-                                        for (const auto& uMember : uType.second) {
 
-                                                std::string lwrStr = uMember.Name;
-                                                std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
+                if (mACProvider != nullptr)
+                        mRequestACProvider();
+        }
+}
 
-                                                size_t loc = lwrStr.find(acWord);
-                                                if (loc != std::string::npos)
-                                                        weights.push_back(ACEntry(uMember.Name, uMember.Name, loc));
-                                        }
-                                }
-                        }
+void TextEditor::SetAutocompleteProvider(AutocompleteProvider aProvider, int aDelay)
+{
+        mCancelACProvider();
+        mACProvider = aProvider;
+        mACProviderDelay = aDelay;
+}
 
-                }
+void TextEditor::mCancelACProvider()
+{
+        if (mACProviderJob != nullptr)
+                *mACProviderJob->mCancel = true;
+        mACProviderJob = nullptr;
+}
 
-                // build the actual list
-                for (const auto& entry : weights)
-                        if (entry.Location == 0)
-                                mACSuggestions.push_back(std::make_pair(entry.DisplayString, entry.Value));
-                for (const auto& entry : weights)
-                        if (entry.Location != 0)
-                                mACSuggestions.push_back(std::make_pair(entry.DisplayString, entry.Value));
+void TextEditor::mRequestACProvider()
+{
+        mCancelACProvider();
+
+        // dispatched by mUpdateACProvider() once the user stops typing for the provider delay
+        auto job = std::make_shared<ACProviderJob>();
+        job->mCancel = std::make_shared<std::atomic<bool>>(false);
+        job->mRequest.mVersion = mTextVersion;
+        job->mRequest.mCursor = GetCursorPosition();
+        job->mRequest.mPrefix = mACWord;
+        job->mRequest.mCancelled = job->mCancel;
+        job->mTime = std::chrono::steady_clock::now();
+        mACProviderJob = job;
+}
 
+void TextEditor::mUpdateACProvider()
+{
+        auto job = mACProviderJob;
+        if (job == nullptr)
+                return;
+
+        // typing further or moving the cursor outdates the request
+        if (job->mRequest.mVersion != mTextVersion || job->mRequest.mCursor != GetCursorPosition()) {
+                mCancelACProvider();
+                return;
+        }
 
-                if (mACSuggestions.size() > 0) {
-                        mACOpened = true;
+        if (!job->mDispatched) {
+                if (std::chrono::steady_clock::now() - job->mTime < std::chrono::milliseconds(mACProviderDelay))
+                        return;
 
-                        if (keepACOpened != nullptr)
-                                *keepACOpened = true;
+                job->mDispatched = true;
+                job->mRequest.mSnapshot = Snapshot();
 
-                        Coordinates curCursor = GetCursorPosition();
-                        curCursor.mColumn--;
+                auto provider = mACProvider;
+                auto run = [job, provider]() {
+                        if (*job->mCancel)
+                                return;
+                        auto results = provider(job->mRequest);
 
-                        mACPosition = FindWordStart(curCursor);
-                }
+                        std::lock_guard<std::mutex> lock(job->mMutex);
+                        job->mResults = std::move(results);
+                        job->mDone = true;
+                };
+                if (mACExecutor != nullptr)
+                        mACExecutor(run);
+                else
+                        std::thread(run).detach();
+                return;
+        }
+
+        std::vector<std::pair<std::string, std::string>> results;
+        {
+                std::lock_guard<std::mutex> lock(job->mMutex);
+                if (!job->mDone)
+                        return;
+                results.swap(job->mResults);
+        }
+        mACProviderJob = nullptr;
+
+        // the results are added after the local suggestions that are already shown
+        if (!mACOpened)
+                mACSuggestions.clear();
+        std::unordered_set<std::string> shown;
+        for (auto& suggestion : mACSuggestions)
+                shown.insert(suggestion.first);
+        for (auto& result : results)
+                if (mACSuggestions.size() < ACMaxSuggestions && shown.insert(result.first).second)
+                        mACSuggestions.push_back(std::move(result));
+
+        if (!mACOpened && !mACSuggestions.empty()) {
+                mACOpened = true;
+                mACIndex = 0;
+                mACSwitched = false;
+                mACWord = job->mRequest.mPrefix;
+
+                Coordinates curCursor = GetCursorPosition();
+                curCursor.mColumn--;
+                mACPosition = FindWordStart(curCursor);
         }
 }
-#else
-void TextEditor::m_buildSuggestions(bool* keepACOpened) { (void)keepACOpened; }
-#endif
 
 ImVec2 TextEditor::CoordinatesToScreenPos(const Coordinates& aPosition) const
 {
@@ -3349,6 +4383,31 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
     mWithinRender = true;
     mCursorPositionChanged = false;
 
+    if (mRecordingInput)
+        RecordInputFrame();
+
+    mUpdateLoad();
+    mUpdateFileViewSearch();
+    mUpdateFileWatch();
+    mUpdateACProvider();
+
+    // the text was changed through another view of the document
+    if (mSeenTextVersion != mTextVersion) {
+        mSeenTextVersion = mTextVersion;
+        mTextChanged = true;
+        mState.mCursorPosition = SanitizeCoordinates(mState.mCursorPosition);
+        mState.mSelectionStart = SanitizeCoordinates(mState.mSelectionStart);
+        mState.mSelectionEnd = SanitizeCoordinates(mState.mSelectionEnd);
+        mInteractiveStart = SanitizeCoordinates(mInteractiveStart);
+        mInteractiveEnd = SanitizeCoordinates(mInteractiveEnd);
+    }
+
+    if (mFileView != nullptr) {
+        RenderFileView(aTitle, aSize, aBorder);
+        mWithinRender = false;
+        return;
+    }
+
     mFindOrigin = ImGui::GetCursorScreenPos();
     float windowWidth = mWindowWidth = ImGui::GetWindowWidth();
     
@@ -3446,115 +4505,29 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
         ImGui::SetNextWindowPos(ImVec2(mFindOrigin.x + windowWidth - mUICalculateSize(250), mFindOrigin.y + mUICalculateSize(50) * (IsDebugging() && mDebugBar)), ImGuiCond_Always);
         ImGui::BeginChild(("##ted_findwnd" + std::string(aTitle)).c_str(), ImVec2(mUICalculateSize(220), mUICalculateSize(mReplaceOpened ? 90 : 40)), true, ImGuiWindowFlags_NoScrollbar);
 
-        // check for findnext shortcut here...
-        ShortcutID curActionID = ShortcutID::Count;
-        ImGuiIO& io = ImGui::GetIO();
-        auto shift = io.KeyShift;
-        auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
-        auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
-        for (int i = 0; i < m_shortcuts.size(); i++) {
-            auto sct = m_shortcuts[i];
-
-            if (sct.Key1 == -1)
-                continue;
-
-#           if IMGUICTE_USE_SDL2
-            SDL_Scancode sc1 = SDL_GetScancodeFromKey(sct.Key1);
-
-            if (ImGui::IsKeyPressed(sc1) && ((sct.Key2 != -1 && ImGui::IsKeyPressed(SDL_GetScancodeFromKey(sct.Key2))) || sct.Key2 == -1)) {
-                if (((sct.Ctrl == 0 && !ctrl) || (sct.Ctrl == 1 && ctrl) || (sct.Ctrl == 2)) &&     // ctrl check
-                    ((sct.Alt == 0 && !alt) || (sct.Alt == 1 && alt) || (sct.Alt == 2)) &&          // alt check
-                    ((sct.Shift == 0 && !shift) || (sct.Shift == 1 && shift) || (sct.Shift == 2))) {// shift check
-                
-                    curActionID = (ShortcutID)i;
-                }
-            }
-#           else
-
-            const ImGuiIO& io = ImGui::GetIO();
-            const bool ctrl  = (io.KeyMods & ImGuiMod_Ctrl)  != 0;
-            const bool alt   = (io.KeyMods & ImGuiMod_Alt)   != 0;
-            const bool shift = (io.KeyMods & ImGuiMod_Shift) != 0;
-
-            const ImGuiKey k1 = (ImGuiKey)sct.Key1;
-            const bool pressed1 = ImGui::IsKeyPressed(k1) ||
-                                  (k1 == ImGuiKey_Enter && ImGui::IsKeyPressed(ImGuiKey_KeypadEnter));
-
-            const bool pressed2 = (sct.Key2 != -1)
-                ? ImGui::IsKeyPressed((ImGuiKey)sct.Key2)
-                : true;
-
-            if (pressed1 && pressed2) {
-                if (((sct.Ctrl  == 0 && !ctrl ) || (sct.Ctrl  == 1 && ctrl ) || (sct.Ctrl  == 2)) &&
-                    ((sct.Alt   == 0 && !alt  ) || (sct.Alt   == 1 && alt  ) || (sct.Alt   == 2)) &&
-                    ((sct.Shift == 0 && !shift) || (sct.Shift == 1 && shift) || (sct.Shift == 2))) {
-                    curActionID = (ShortcutID)i;
-                }
-            }
-
-#           endif
-        }
-        mFindNext = curActionID == ShortcutID::FindNext;
+        mFindNext = IsShortcutPressed(ShortcutID::FindNext);
 
         if (mFindJustOpened) {
             std::string txt = GetSelectedText();
-            if (txt.size() > 0)
+            if (txt.size() > 0 && txt.size() < sizeof(mFindWord))
                 strcpy(mFindWord, txt.c_str());
         }
 
-        ImGui::PushItemWidth(mUICalculateSize(-45));
+        bool invalidPattern = mSearchJob != nullptr && mSearchJob->mInvalid;
+        if (invalidPattern)
+            ImGui::PushStyleColor(ImGuiCol_Text, ImGui::ColorConvertU32ToFloat4(mPalette[(int)PaletteIndex::ErrorMessage]));
+        ImGui::PushItemWidth(mUICalculateSize(-95));
         if (ImGui::InputText(("##ted_findtextbox" + std::string(aTitle)).c_str(), mFindWord, 256, ImGuiInputTextFlags_EnterReturnsTrue) || mFindNext) {
-            auto curPos = mState.mCursorPosition;
-            size_t cindex = 0;
-            for (size_t ln = 0; ln < curPos.mLine; ln++)
-                cindex += GetLineCharacterCount(ln) + 1;
-            cindex += curPos.mColumn;
-
-            std::string wordLower = mFindWord;
-            std::transform(wordLower.begin(), wordLower.end(), wordLower.begin(), ::tolower);
-
-            std::string textSrc = GetText();
-            std::transform(textSrc.begin(), textSrc.end(), textSrc.begin(), ::tolower);
-
-            size_t textLoc = textSrc.find(wordLower, cindex);
-            if (textLoc == std::string::npos)
-                textLoc = textSrc.find(wordLower, 0);
+            // the match is selected once the search worker has reached it
+            mSearchAction = SearchAction::Find;
 
-
-            if (textLoc != std::string::npos) {
-                curPos.mLine = curPos.mColumn = 0;
-                cindex = 0;
-                for (size_t ln = 0; ln < mLines.size(); ln++) {
-                    int charCount = GetLineCharacterCount(ln) + 1;
-                    if (cindex + charCount > textLoc) {
-                        curPos.mLine = ln;
-                        curPos.mColumn = textLoc - cindex;
-
-                        auto& line = mLines[curPos.mLine];
-                        for (int i = 0; i < line.size(); i++)
-                            if (line[i].mChar == '\t')
-                                curPos.mColumn += (mTabSize - 1);
-
-                        break;
-                    }
-                    else {// just keep adding
-                        cindex += charCount;
-                    }
-                }
-
-
-                auto selStart = curPos, selEnd = curPos;
-                selEnd.mColumn += strlen(mFindWord);
-                SetSelection(curPos, selEnd);
-                SetCursorPosition(selEnd);
-                mScrollToCursor = true;
-
-                if (!mFindNext)
-                    ImGui::SetKeyboardFocusHere(0);
-            }
+            if (!mFindNext)
+                ImGui::SetKeyboardFocusHere(0);
 
             mFindNext = false;
         }
+        if (invalidPattern)
+            ImGui::PopStyleColor();
         if (ImGui::IsItemActive())
             mFindFocused = true;
         else
@@ -3565,6 +4538,22 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
         }
         ImGui::PopItemWidth();
 
+        ImGui::SameLine();
+        if (mFindRegex)
+            ImGui::PushStyleColor(ImGuiCol_Button, ImGui::GetStyle().Colors[ImGuiCol_ButtonActive]);
+        if (ImGui::Button((".*##findRegex" + std::string(aTitle)).c_str()))
+            mFindRegex = !mFindRegex;
+        if (mFindRegex)
+            ImGui::PopStyleColor();
+
+        ImGui::SameLine();
+        if (mFindCaseSensitive)
+            ImGui::PushStyleColor(ImGuiCol_Button, ImGui::GetStyle().Colors[ImGuiCol_ButtonActive]);
+        if (ImGui::Button(("Aa##findCase" + std::string(aTitle)).c_str()))
+            mFindCaseSensitive = !mFindCaseSensitive;
+        if (mFindCaseSensitive)
+            ImGui::PopStyleColor();
+
         if (!mReadOnly) {
             ImGui::SameLine();
             if (ImGui::ArrowButton(("##expandFind" + std::string(aTitle)).c_str(), mReplaceOpened ? ImGuiDir_Up : ImGuiDir_Down))
@@ -3587,279 +4576,1316 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
                 mReplaceFocused = false;
             ImGui::PopItemWidth();
 
-            ImGui::SameLine();
-            if (ImGui::Button((">##replaceOne" + std::string(aTitle)).c_str()) || shouldReplace) {
-                if (strlen(mFindWord) > 0) {
-                    auto curPos = mState.mCursorPosition;
-                    
-                    std::string textSrc = GetText();
-                    if (mReplaceIndex >= textSrc.size())
-                        mReplaceIndex = 0;
-                    size_t textLoc = textSrc.find(mFindWord, mReplaceIndex);
-                    if (textLoc == std::string::npos) {
-                        mReplaceIndex = 0;
-                        textLoc = textSrc.find(mFindWord, 0);
-                    }
+            ImGui::SameLine();
+            if (ImGui::Button((">##replaceOne" + std::string(aTitle)).c_str()) || shouldReplace) {
+                if (strlen(mFindWord) > 0)
+                    mSearchAction = SearchAction::Replace;
+            }
+
+            ImGui::SameLine();
+            if (ImGui::Button((">>##replaceAll" + std::string(aTitle)).c_str())) {
+                if (strlen(mFindWord) > 0)
+                    mSearchAction = SearchAction::ReplaceAll;
+            }
+        }
+
+        ImGui::EndChild();
+
+        ImGui::PushFont(font);
+
+        mUpdateSearch();
+
+        if (ImGui::IsKeyPressed(ImGuiKey_Escape))
+            mFindOpened = false;
+    }
+    else if (mSearchJob != nullptr) {
+        mCancelSearch();
+    }
+
+    /* DEBUGGER CONTROLS */
+    if (IsDebugging() && mDebugBar)
+    {
+        ImFont* font = ImGui::GetFont();
+        ImGui::PopFont();
+
+
+        ImGui::SetNextWindowPos(ImVec2(mFindOrigin.x + windowWidth / 2 - mDebugBarWidth / 2, mFindOrigin.y), ImGuiCond_Always);
+        ImGui::BeginChild(("##ted_dbgcontrols" + std::string(aTitle)).c_str(), ImVec2(mDebugBarWidth, mDebugBarHeight), true, ImGuiWindowFlags_NoScrollbar);
+
+        ImVec2 dbBarStart = ImGui::GetCursorPos();
+
+        if (ImGui::Button(("Step##ted_dbgstep" + std::string(aTitle)).c_str()) && OnDebuggerAction)
+            OnDebuggerAction(this, DebugAction::Step);
+        ImGui::SameLine(0, 6);
+
+        if (ImGui::Button(("Step In##ted_dbgstepin" + std::string(aTitle)).c_str()) && OnDebuggerAction)
+            OnDebuggerAction(this, DebugAction::StepInto);
+        ImGui::SameLine(0, 6);
+
+        if (ImGui::Button(("Step Out##ted_dbgstepout" + std::string(aTitle)).c_str()) && OnDebuggerAction)
+            OnDebuggerAction(this, DebugAction::StepOut);
+        ImGui::SameLine(0, 6);
+
+        if (ImGui::Button(("Continue##ted_dbgcontinue" + std::string(aTitle)).c_str()) && OnDebuggerAction)
+            OnDebuggerAction(this, DebugAction::Continue);
+        ImGui::SameLine(0, 6);
+
+        if (ImGui::Button(("Stop##ted_dbgstop" + std::string(aTitle)).c_str()) && OnDebuggerAction)
+            OnDebuggerAction(this, DebugAction::Stop);
+
+        ImVec2 dbBarEnd = ImGui::GetCursorPos();
+        mDebugBarHeight = dbBarEnd.y - dbBarStart.y + ImGui::GetStyle().WindowPadding.y * 2.0f;
+
+        ImGui::SameLine(0, 6);
+
+        dbBarEnd = ImGui::GetCursorPos();
+        mDebugBarWidth = dbBarEnd.x - dbBarStart.x + ImGui::GetStyle().WindowPadding.x * 2.0f;
+
+        ImGui::EndChild();
+
+        ImGui::PushFont(font);
+    }
+
+    if (!mIgnoreImGuiChild)
+        ImGui::EndChild();
+    ImGui::PopStyleColor();
+    ImGui::PopStyleVar();
+
+    // breakpoint condition popup
+    if (openBkptConditionWindow)
+        ImGui::OpenPopup("Condition##condition");
+
+    ImFont* font = ImGui::GetFont();
+    ImGui::PopFont();
+    ImGui::SetNextWindowSize(ImVec2(430, 175), ImGuiCond_Once);
+    if (ImGui::BeginPopupModal("Condition##condition")) {
+        ImGui::Checkbox("Use condition", &mPopupCondition_Use);
+
+        if (!mPopupCondition_Use) {
+            ImGui::PushItemFlag(ImGuiItemFlags_Disabled, true);
+            ImGui::PushStyleVar(ImGuiStyleVar_Alpha, ImGui::GetStyle().Alpha * 0.5f);
+        }
+        ImGui::InputText("Condition", mPopupCondition_Condition, 512);
+        if (!mPopupCondition_Use) {
+            ImGui::PopStyleVar();
+            ImGui::PopItemFlag();
+        }
+
+        if (ImGui::Button("Cancel"))
+            ImGui::CloseCurrentPopup();
+        ImGui::SameLine();
+        if (ImGui::Button("OK")) {
+            size_t clen = strlen(mPopupCondition_Condition);
+            bool isEmpty = true;
+            for (size_t i = 0; i < clen; i++)
+                if (!isspace(mPopupCondition_Condition[i])) {
+                    isEmpty = false;
+                    break;
+                }
+            Breakpoint& bkpt = GetBreakpoint(mPopupCondition_Line);
+            bkpt.mCondition = mPopupCondition_Condition;
+            bkpt.mUseCondition = (mPopupCondition_Use && !isEmpty);
+
+            if (OnBreakpointUpdate)
+                OnBreakpointUpdate(this, bkpt.mLine, bkpt.mUseCondition, bkpt.mCondition, bkpt.mEnabled);
+
+            ImGui::CloseCurrentPopup();
+        }
+        ImGui::EndPopup();
+    }
+    ImGui::PushFont(font);
+
+    FlushTextChanges();
+
+    mWithinRender = false;
+}
+
+void TextEditor::RecordInputFrame()
+{
+    // positions are stored relative to the editor so that the replay can host it anywhere
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+
+    InputFrame frame;
+    frame.mDeltaTime = ImGui::GetIO().DeltaTime;
+    for (auto& event : ImGui::GetCurrentContext()->InputEventsTrail) {
+        InputEvent recorded;
+        recorded.mCode = 0;
+        recorded.mDown = false;
+        recorded.mValue = ImVec2(0.0f, 0.0f);
+        switch (event.Type) {
+            case ImGuiInputEventType_Key:
+                recorded.mType = InputEvent::Type::Key;
+                recorded.mCode = (int)event.Key.Key;
+                recorded.mDown = event.Key.Down;
+                break;
+            case ImGuiInputEventType_Text:
+                recorded.mType = InputEvent::Type::Char;
+                recorded.mCode = (int)event.Text.Char;
+                break;
+            case ImGuiInputEventType_MousePos:
+                recorded.mType = InputEvent::Type::MousePos;
+                recorded.mValue = ImVec2(event.MousePos.PosX - origin.x, event.MousePos.PosY - origin.y);
+                break;
+            case ImGuiInputEventType_MouseButton:
+                recorded.mType = InputEvent::Type::MouseButton;
+                recorded.mCode = event.MouseButton.Button;
+                recorded.mDown = event.MouseButton.Down;
+                break;
+            case ImGuiInputEventType_MouseWheel:
+                recorded.mType = InputEvent::Type::MouseWheel;
+                recorded.mValue = ImVec2(event.MouseWheel.WheelX, event.MouseWheel.WheelY);
+                break;
+            case ImGuiInputEventType_Focus:
+                recorded.mType = InputEvent::Type::Focus;
+                recorded.mDown = event.AppFocused.Focused;
+                break;
+            default:
+                continue;
+        }
+        frame.mEvents.push_back(recorded);
+    }
+    mInputRecording.push_back(std::move(frame));
+}
+
+TextEditor::InputRecording TextEditor::StopInputRecording()
+{
+    mRecordingInput = false;
+    InputRecording recording;
+    recording.swap(mInputRecording);
+    return recording;
+}
+
+bool TextEditor::SaveInputRecording(const InputRecording& aRecording, std::ostream& aStream)
+{
+    // one "frame" line per frame followed by its clipboard text and one line per event
+    auto precision = aStream.precision(9); // floats round-trip exactly
+    aStream << "imtextedit-input 1\n";
+    for (auto& frame : aRecording) {
+        aStream << "frame " << frame.mDeltaTime << ' ' << frame.mEvents.size() << ' ';
+        if (frame.mHasClipboard)
+            aStream << frame.mClipboard.size() << '\n' << frame.mClipboard;
+        else
+            aStream << -1;
+        aStream << '\n';
+        for (auto& event : frame.mEvents)
+            aStream << (int)event.mType << ' ' << event.mCode << ' ' << (int)event.mDown << ' ' << event.mValue.x << ' ' << event.mValue.y << '\n';
+    }
+    aStream.precision(precision);
+    return !aStream.fail();
+}
+
+bool TextEditor::LoadInputRecording(InputRecording& aRecording, std::istream& aStream)
+{
+    aRecording.clear();
+
+    std::string tag;
+    int version = 0;
+    if (!(aStream >> tag >> version) || tag != "imtextedit-input" || version != 1)
+        return false;
+
+    while (aStream >> tag) {
+        if (tag != "frame")
+            return false;
+
+        InputFrame frame;
+        size_t eventCount = 0;
+        long long clipboardSize = 0;
+        if (!(aStream >> frame.mDeltaTime >> eventCount >> clipboardSize))
+            return false;
+        if (clipboardSize >= 0) {
+            aStream.get(); // line break before the clipboard text
+            frame.mHasClipboard = true;
+            frame.mClipboard.resize((size_t)clipboardSize);
+            if (clipboardSize > 0 && !aStream.read(&frame.mClipboard[0], clipboardSize))
+                return false;
+        }
+
+        frame.mEvents.resize(eventCount);
+        for (auto& event : frame.mEvents) {
+            int type = 0, down = 0;
+            if (!(aStream >> type >> event.mCode >> down >> event.mValue.x >> event.mValue.y))
+                return false;
+            if (type < 0 || type > (int)InputEvent::Type::Focus)
+                return false;
+            event.mType = (InputEvent::Type)type;
+            event.mDown = down != 0;
+        }
+        aRecording.push_back(std::move(frame));
+    }
+    return aStream.eof();
+}
+
+TextEditor::ReplayStats TextEditor::ReplayInput(const InputRecording& aRecording, const ImVec2& aSize)
+{
+    ImGuiContext* previous = ImGui::GetCurrentContext();
+    ImGuiContext* context = ImGui::CreateContext();
+    ImGui::SetCurrentContext(context);
+
+    // headless: the font atlas is built but never uploaded, the draw data is discarded
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = aSize;
+    io.IniFilename = nullptr;
+    io.ConfigInputTrickleEventQueue = false; // each recorded frame is processed in one frame
+    unsigned char* pixels = nullptr;
+    int width = 0, height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    ReplayStats stats;
+    ImVec2 origin(0.0f, 0.0f);
+    auto frame = [&](const InputFrame* aFrame) {
+        if (aFrame != nullptr) {
+            io.DeltaTime = aFrame->mDeltaTime > 0.0f ? aFrame->mDeltaTime : 1.0f / 60.0f;
+            if (aFrame->mHasClipboard)
+                ImGui::SetClipboardText(aFrame->mClipboard.c_str());
+            for (auto& event : aFrame->mEvents) {
+                switch (event.mType) {
+                    case InputEvent::Type::Key: io.AddKeyEvent((ImGuiKey)event.mCode, event.mDown); break;
+                    case InputEvent::Type::Char: io.AddInputCharacter((unsigned int)event.mCode); break;
+                    case InputEvent::Type::MousePos: io.AddMousePosEvent(origin.x + event.mValue.x, origin.y + event.mValue.y); break;
+                    case InputEvent::Type::MouseButton: io.AddMouseButtonEvent(event.mCode, event.mDown); break;
+                    case InputEvent::Type::MouseWheel: io.AddMouseWheelEvent(event.mValue.x, event.mValue.y); break;
+                    case InputEvent::Type::Focus: io.AddFocusEvent(event.mDown); break;
+                }
+            }
+        } else
+            io.DeltaTime = 1.0f / 60.0f;
+
+        auto start = std::chrono::steady_clock::now();
+        ImGui::NewFrame();
+        ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+        ImGui::SetNextWindowSize(aSize);
+        ImGui::Begin("##texteditor_replay", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoSavedSettings);
+        origin = ImGui::GetCursorScreenPos();
+        if (aFrame == nullptr)
+            ImGui::SetNextWindowFocus();
+        Render("##texteditor_replay_editor");
+        ImGui::End();
+        ImGui::Render();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // the first frame lays the window out and focuses the editor
+    frame(nullptr);
+    for (auto& recorded : aRecording) {
+        double time = frame(&recorded);
+        stats.mFrameTimes.push_back(time);
+
+        bool typed = false;
+        for (auto& event : recorded.mEvents)
+            typed |= event.mType == InputEvent::Type::Char || (event.mType == InputEvent::Type::Key && event.mDown);
+        if (typed)
+            stats.mKeystrokeTimes.push_back(time);
+    }
+
+    ImGui::DestroyContext(context);
+    ImGui::SetCurrentContext(previous);
+    return stats;
+}
+
+void TextEditor::BuildLine(Line& aLine, int aIndex, const char* aText, size_t aSize, int aTabSize, std::vector<Coordinates>& aFoldBegin, std::vector<Coordinates>& aFoldEnd)
+{
+    if (aSize > 0 && aText[aSize - 1] == '\r')
+        aSize--;
+
+    // sized up front, the line never reallocates
+    aLine.reserve(aSize);
+
+    int column = 0;
+    for (size_t i = 0; i < aSize; i++) {
+        char chr = aText[i];
+        if (chr == '\r')
+            continue; // ignore the carriage return character
+
+        if (chr == '{')
+            aFoldBegin.push_back(Coordinates(aIndex, column));
+        else if (chr == '}')
+            aFoldEnd.push_back(Coordinates(aIndex, column));
+
+        aLine.emplace_back(Glyph(chr, PaletteIndex::Default));
+
+        if (chr == '\t')
+            column = (column / aTabSize) * aTabSize + aTabSize;
+        else if (!IsUTFSequence(chr))
+            column++;
+    }
+}
+
+void TextEditor::LoadLines(const std::vector<std::pair<const char*, size_t>>& aLines)
+{
+    ResizeLineWords(0);
+    mDocument->mSnapshotLines.clear();
+    mDocument->mSnapshotStale = true;
+    mLines.clear();
+    mLines.resize(std::max<size_t>(1, aLines.size()));
+    mFoldBegin.clear();
+    mFoldEnd.clear();
+    mFoldSorted = false;
+
+    // a new text replaces a file that is still being loaded or viewed
+    if (mLoadJob != nullptr) {
+        mLoadJob->mCancel = true;
+        mLoadJob = nullptr;
+    }
+    CloseFileView();
+
+    // the folds of a range of lines are collected in order
+    auto build = [&](size_t aFrom, size_t aTo, std::vector<Coordinates>& aFoldBegin, std::vector<Coordinates>& aFoldEnd) {
+        for (size_t i = aFrom; i < aTo; i++)
+            BuildLine(mLines[i], (int)i, aLines[i].first, aLines[i].second, mTabSize, aFoldBegin, aFoldEnd);
+    };
+
+    size_t total = 0;
+    for (auto& line : aLines)
+        total += line.second;
+
+    unsigned int workerCount = std::thread::hardware_concurrency();
+    if (total < ParallelLoadThreshold || workerCount < 2 || aLines.size() < workerCount) {
+        build(0, aLines.size(), mFoldBegin, mFoldEnd);
+        return;
+    }
+
+    // large documents: split the lines into chunks of similar byte size and build them on all cores
+    std::vector<std::vector<Coordinates>> foldBegin(workerCount), foldEnd(workerCount);
+    std::vector<std::thread> workers;
+    size_t from = 0;
+    for (unsigned int w = 0; w < workerCount; w++) {
+        size_t to = from;
+        if (w == workerCount - 1)
+            to = aLines.size();
+        else {
+            for (size_t chunk = 0; to < aLines.size() && chunk < total / workerCount; to++)
+                chunk += aLines[to].second + 1;
+        }
+
+        workers.emplace_back(build, from, to, std::ref(foldBegin[w]), std::ref(foldEnd[w]));
+        from = to;
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    for (unsigned int w = 0; w < workerCount; w++) {
+        mFoldBegin.insert(mFoldBegin.end(), foldBegin[w].begin(), foldBegin[w].end());
+        mFoldEnd.insert(mFoldEnd.end(), foldEnd[w].begin(), foldEnd[w].end());
+    }
+}
+
+void TextEditor::SetText(const std::string & aText)
+{
+    assert(mEditDepth == 0);
+
+    Coordinates oldEnd;
+    if (WantsTextChanges() && !mLines.empty())
+        oldEnd = Coordinates((int)mLines.size() - 1, (int)mLines.back().size());
+
+    // find the line boundaries first
+    std::vector<std::pair<const char*, size_t>> lines;
+    const char* text = aText.data();
+    const char* end = text + aText.size();
+    while (true) {
+        auto next = (const char*)memchr(text, '\n', end - text);
+        if (next == nullptr) {
+            lines.emplace_back(text, end - text);
+            break;
+        }
+        lines.emplace_back(text, next - text);
+        text = next + 1;
+    }
+
+    LoadLines(lines);
+
+    mTextChanged = true;
+    mTextVersion++;
+    mSeenTextVersion = mTextVersion;
+    mScrollToTop = true;
+
+    mUndoBuffer.clear();
+    mUndoIndex = 0;
+
+    if (WantsTextChanges())
+        AddTextChange(Coordinates(), oldEnd, GetText());
+
+    Colorize();
+}
+
+void TextEditor::ReloadText(const std::string& aText)
+{
+    assert(mEditDepth == 0);
+
+    // carriage returns never make it into the lines
+    std::string text;
+    text.reserve(aText.size());
+    for (char c : aText)
+        if (c != '\r')
+            text += c;
+
+    std::vector<std::pair<const char*, size_t>> lines;
+    const char* start = text.data();
+    const char* end = start + text.size();
+    while (true) {
+        auto next = (const char*)memchr(start, '\n', end - start);
+        if (next == nullptr) {
+            lines.emplace_back(start, end - start);
+            break;
+        }
+        lines.emplace_back(start, next - start);
+        start = next + 1;
+    }
+
+    // lines are compared by hash first
+    auto hash = [](uint64_t aHash, char aChar) { return (aHash ^ (uint8_t)aChar) * 1099511628211ull; };
+    std::vector<uint64_t> oldHashes(mLines.size(), 14695981039346656037ull), newHashes(lines.size(), 14695981039346656037ull);
+    for (size_t i = 0; i < mLines.size(); i++)
+        for (auto& glyph : mLines[i])
+            oldHashes[i] = hash(oldHashes[i], glyph.mChar);
+    for (size_t i = 0; i < lines.size(); i++)
+        for (size_t j = 0; j < lines[i].second; j++)
+            newHashes[i] = hash(newHashes[i], lines[i].first[j]);
+
+    auto equal = [&](int aOld, int aNew) {
+        auto& line = mLines[aOld];
+        if (oldHashes[aOld] != newHashes[aNew] || line.size() != lines[aNew].second)
+            return false;
+        for (size_t i = 0; i < line.size(); i++)
+            if (line[i].mChar != lines[aNew].first[i])
+                return false;
+        return true;
+    };
+    // the text now matches the file, the file watch reloads its next change again
+    mFileSaved = false;
+
+    auto hunks = DiffLines((int)mLines.size(), (int)lines.size(), equal);
+    if (hunks.empty()) {
+        mFileVersion = mTextVersion;
+        return;
+    }
+
+    // every hunk becomes an edit, the last line has no line break to replace
+    int oldCount = (int)mLines.size();
+    int lastLine = oldCount - 1;
+    std::vector<TextEdit> edits;
+    for (auto& hunk : hunks) {
+        TextEdit edit;
+        for (int i = hunk.mNewStart; i < hunk.mNewEnd; i++) {
+            edit.mText.append(lines[i].first, lines[i].second);
+            if (hunk.mOldEnd < oldCount || i + 1 < hunk.mNewEnd)
+                edit.mText += '\n';
+        }
+
+        if (hunk.mOldEnd < oldCount) {
+            edit.mStart = Coordinates(hunk.mOldStart, 0);
+            edit.mEnd = Coordinates(hunk.mOldEnd, 0);
+        } else if (hunk.mOldStart == hunk.mOldEnd) {
+            edit.mStart = edit.mEnd = Coordinates(lastLine, GetLineMaxColumn(lastLine));
+            edit.mText.insert(0, 1, '\n');
+        } else if (hunk.mNewStart == hunk.mNewEnd) {
+            edit.mStart = Coordinates(hunk.mOldStart - 1, GetLineMaxColumn(hunk.mOldStart - 1));
+            edit.mEnd = Coordinates(lastLine, GetLineMaxColumn(lastLine));
+        } else {
+            edit.mStart = Coordinates(hunk.mOldStart, 0);
+            edit.mEnd = Coordinates(lastLine, GetLineMaxColumn(lastLine));
+        }
+        edits.push_back(std::move(edit));
+    }
+
+    // a reload also updates read-only documents
+    bool readOnly = mReadOnly;
+    mReadOnly = false;
+    ApplyEdits(std::move(edits));
+    mReadOnly = readOnly;
+    mFileVersion = mTextVersion;
+}
+
+void TextEditor::SetPath(const std::string& aPath)
+{
+    mPath = aPath;
+
+    // the watch follows the path
+    if (mFileWatch != nullptr)
+        SetFileWatch(true, mFileWatch->mPolling);
+}
+
+void TextEditor::SetFileWatch(bool aValue, bool aPolling)
+{
+    if (mFileWatch != nullptr) {
+        mFileWatch->mCancel = true;
+        mFileWatch = nullptr;
+    }
+    if (!aValue)
+        return;
+
+    auto watch = std::make_shared<FileWatch>();
+    watch->mPath = mPath;
+    watch->mPolling = aPolling;
+    watch->mDelay = mFileWatchDelay;
+    mFileWatch = watch;
+    mFileVersion = mTextVersion;    // the text shown is taken as the file's
+    mFileSaved = false;
+    if (!mPath.empty())
+        std::thread(mRunFileWatch, watch).detach();
+}
+
+void TextEditor::MarkFileSaved()
+{
+    mFileVersion = mTextVersion;
+    mFileSavedHash = HashText();
+    mFileSaved = true;
+}
+
+// FNV-1a, continued over consecutive chunks
+static uint64_t HashBytes(const char* aData, size_t aSize, uint64_t aHash = 14695981039346656037ull)
+{
+    for (size_t i = 0; i < aSize; i++)
+        aHash = (aHash ^ (uint8_t)aData[i]) * 1099511628211ull;
+    return aHash;
+}
+
+uint64_t TextEditor::HashText() const
+{
+    uint64_t hash = HashBytes(nullptr, 0);
+    ForEachChunk([&](const char* aData, size_t aSize) {
+        hash = HashBytes(aData, aSize, hash);
+        return true;
+    });
+    return hash;
+}
+
+// modification time with sub-second precision where the platform has it, so that two writes
+// within the same second are both seen by the polling watch
+static bool GetFileStamp(const std::string& aPath, uint64_t& aTime, uint64_t& aSize)
+{
+#if defined(_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(aPath.c_str(), GetFileExInfoStandard, &info))
+        return false;
+
+    aTime = ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime; // 100ns units
+    aSize = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+#else
+    struct stat info;
+    if (stat(aPath.c_str(), &info) != 0)
+        return false;
+
+#if defined(__linux__)
+    aTime = (uint64_t)info.st_mtim.tv_sec * 1000000000ull + (uint64_t)info.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    aTime = (uint64_t)info.st_mtimespec.tv_sec * 1000000000ull + (uint64_t)info.st_mtimespec.tv_nsec;
+#else
+    aTime = (uint64_t)info.st_mtime;
+#endif
+    aSize = (uint64_t)info.st_size;
+#endif
+    return true;
+}
+
+void TextEditor::mRunFileWatch(std::shared_ptr<FileWatch> aWatch)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::string directory = ".", name = aWatch->mPath;
+    size_t separator = aWatch->mPath.find_last_of("/\\");
+    if (separator != std::string::npos) {
+        directory = aWatch->mPath.substr(0, std::max<size_t>(separator, 1));
+        name = aWatch->mPath.substr(separator + 1);
+    }
+
+#if defined(__linux__)
+    // editors and build tools often replace the file, so the directory is watched
+    int notify = -1;
+    if (!aWatch->mPolling) {
+        notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (notify != -1 && inotify_add_watch(notify, directory.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE) == -1) {
+            close(notify);
+            notify = -1;
+        }
+    }
+#endif
+
+    uint64_t time = 0, size = 0;
+    GetFileStamp(aWatch->mPath, time, size);
+
+    bool changed = false;
+    Clock::time_point lastChange;
+    while (!aWatch->mCancel) {
+        bool event = false;
+#if defined(__linux__)
+        if (notify != -1) {
+            pollfd descriptor = { notify, POLLIN, 0 };
+            if (poll(&descriptor, 1, FileWatchPollInterval) > 0) {
+                alignas(inotify_event) char buffer[4096];
+                ssize_t length;
+                while ((length = read(notify, buffer, sizeof(buffer))) > 0) {
+                    for (char* at = buffer; at < buffer + length;) {
+                        auto notification = (const inotify_event*)at;
+                        if (notification->len > 0 && name == notification->name)
+                            event = true;
+                        at += sizeof(inotify_event) + notification->len;
+                    }
+                }
+            }
+        } else
+#endif
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(FileWatchPollInterval));
+            uint64_t newTime = 0, newSize = 0;
+            if (GetFileStamp(aWatch->mPath, newTime, newSize) && (newTime != time || newSize != size)) {
+                time = newTime;
+                size = newSize;
+                event = true;
+            }
+        }
+
+        if (event) {
+            changed = true;
+            lastChange = Clock::now();
+        }
+
+        // bursts of writes are read once they settle
+        if (!changed || Clock::now() - lastChange < std::chrono::milliseconds(aWatch->mDelay))
+            continue;
+        changed = false;
+
+        FILE* file = fopen(aWatch->mPath.c_str(), "rb");
+        if (file == nullptr)
+            continue;
+
+        std::string text;
+        char chunk[64 * 1024];
+        size_t read;
+        while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            text.append(chunk, read);
+        fclose(file);
+
+        std::lock_guard<std::mutex> lock(aWatch->mMutex);
+        aWatch->mText = std::move(text);
+        aWatch->mPending = true;
+    }
+
+#if defined(__linux__)
+    if (notify != -1)
+        close(notify);
+#endif
+}
+
+void TextEditor::mUpdateFileWatch()
+{
+    auto watch = mFileWatch;
+    if (watch == nullptr || mLoadJob != nullptr || mFileView != nullptr)
+        return;
+
+    std::string text;
+    {
+        std::lock_guard<std::mutex> lock(watch->mMutex);
+        if (!watch->mPending)
+            return;
+        text.swap(watch->mText);
+        watch->mPending = false;
+    }
+
+    // the write of our own save: the edits made since then are newer than the file
+    uint64_t hash = HashBytes(text.data(), text.size());
+    if (mFileSaved && hash == mFileSavedHash)
+        return;
+
+    if (hash == HashText()) {
+        mFileVersion = mTextVersion;
+        return;
+    }
+
+    // unsaved edits are never overwritten, the host decides what to keep
+    if (mFileVersion != mTextVersion) {
+        if (OnFileConflict != nullptr)
+            OnFileConflict(this, text);
+        return;
+    }
+
+    // only the changed lines are replaced
+    uint64_t version = mTextVersion;
+    ReloadText(text);
+    if (version != mTextVersion && OnFileReload != nullptr)
+        OnFileReload(this);
+}
+
+bool TextEditor::LoadFileAsync(const std::string& aPath)
+{
+    assert(mEditDepth == 0);
+
+    FILE* file = fopen(aPath.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    // start from an empty document, the placeholder line is replaced by the first chunk
+    SetText("");
+    mLoadFirstChunk = true;
+
+    auto job = std::make_shared<LoadJob>();
+    job->mFile = file;
+    job->mTabSize = mTabSize;
+#ifdef _WIN32
+    if (_fseeki64(file, 0, SEEK_END) == 0) {
+        __int64 size = _ftelli64(file);
+        job->mSize = size > 0 ? (size_t)size : 0;
+    }
+    _fseeki64(file, 0, SEEK_SET);
+#else
+    if (fseeko(file, 0, SEEK_END) == 0) {
+        off_t size = ftello(file);
+        job->mSize = size > 0 ? (size_t)size : 0;
+    }
+    fseeko(file, 0, SEEK_SET);
+#endif
+    mLoadJob = job;
+
+    std::thread(mRunLoad, job).detach();
+    return true;
+}
+
+void TextEditor::CancelLoad()
+{
+    if (mLoadJob == nullptr)
+        return;
+
+    // keep whatever the worker has already read
+    mLoadJob->mCancel = true;
+    mUpdateLoad();
+    mLoadJob = nullptr;
+}
+
+void TextEditor::mRunLoad(std::shared_ptr<LoadJob> aJob)
+{
+    const size_t chunkSize = 1 << 20;
+    std::vector<char> buffer(chunkSize);
+    std::string partial; // line continued from the previous chunk
+
+    std::vector<Line> lines;
+    std::vector<Coordinates> foldBegin, foldEnd;
+    size_t read = 0;
+    bool eof = false;
+    while (!eof && !aJob->mCancel) {
+        size_t count = fread(buffer.data(), 1, chunkSize, aJob->mFile);
+        eof = count < chunkSize;
+        read += count;
+
+        const char* text = buffer.data();
+        const char* end = text + count;
+        while (true) {
+            auto next = (const char*)memchr(text, '\n', end - text);
+            if (next == nullptr) {
+                partial.append(text, end);
+                break;
+            }
+
+            lines.emplace_back();
+            if (partial.empty())
+                BuildLine(lines.back(), (int)lines.size() - 1, text, next - text, aJob->mTabSize, foldBegin, foldEnd);
+            else {
+                partial.append(text, next);
+                BuildLine(lines.back(), (int)lines.size() - 1, partial.data(), partial.size(), aJob->mTabSize, foldBegin, foldEnd);
+                partial.clear();
+            }
+            text = next + 1;
+        }
+        if (eof) {
+            lines.emplace_back();
+            BuildLine(lines.back(), (int)lines.size() - 1, partial.data(), partial.size(), aJob->mTabSize, foldBegin, foldEnd);
+        }
+
+        // publish the chunk, fold lines are relative to the pending lines
+        std::lock_guard<std::mutex> lock(aJob->mMutex);
+        int offset = (int)aJob->mPending.size();
+        for (auto& fold : foldBegin)
+            aJob->mPendingFoldBegin.push_back(Coordinates(fold.mLine + offset, fold.mColumn));
+        for (auto& fold : foldEnd)
+            aJob->mPendingFoldEnd.push_back(Coordinates(fold.mLine + offset, fold.mColumn));
+        aJob->mPending.insert(aJob->mPending.end(), std::make_move_iterator(lines.begin()), std::make_move_iterator(lines.end()));
+        aJob->mRead = read;
+
+        lines.clear();
+        foldBegin.clear();
+        foldEnd.clear();
+    }
+
+    fclose(aJob->mFile);
+    aJob->mFile = nullptr;
+
+    std::lock_guard<std::mutex> lock(aJob->mMutex);
+    aJob->mDone = true;
+}
+
+void TextEditor::mUpdateLoad()
+{
+    auto job = mLoadJob;
+    if (job == nullptr)
+        return;
+
+    std::vector<Line> lines;
+    std::vector<Coordinates> foldBegin, foldEnd;
+    size_t read = 0;
+    bool done = false;
+    {
+        std::lock_guard<std::mutex> lock(job->mMutex);
+        lines.swap(job->mPending);
+        foldBegin.swap(job->mPendingFoldBegin);
+        foldEnd.swap(job->mPendingFoldEnd);
+        read = job->mRead;
+        done = job->mDone;
+    }
+
+    if (!lines.empty()) {
+        // the first chunk replaces the placeholder line unless it has been typed into
+        Coordinates start;
+        bool replace = mLoadFirstChunk && mLines.size() == 1 && mLines[0].empty();
+        if (replace)
+            mLines.clear();
+        else
+            start = Coordinates((int)mLines.size() - 1, (int)mLines.back().size());
+        mLoadFirstChunk = false;
+
+        int first = (int)mLines.size();
+        mLines.insert(mLines.end(), std::make_move_iterator(lines.begin()), std::make_move_iterator(lines.end()));
+        for (auto& fold : foldBegin)
+            mFoldBegin.push_back(Coordinates(fold.mLine + first, fold.mColumn));
+        for (auto& fold : foldEnd)
+            mFoldEnd.push_back(Coordinates(fold.mLine + first, fold.mColumn));
+        mFoldSorted = false;
+
+        MarkTextChanged();
+        if (WantsTextChanges()) {
+            int last = (int)mLines.size() - 1;
+            std::string text = GetText(Coordinates(first, 0), Coordinates(last, GetLineMaxColumn(last)));
+            AddTextChange(start, start, replace ? text : "\n" + text);
+        }
+        Colorize(first, (int)lines.size());
+    }
+
+    if (done) {
+        mLoadJob = nullptr;
+        mFileVersion = mTextVersion;
+        mFileSaved = false;
+    }
+
+    if ((!lines.empty() || done) && OnLoadProgress != nullptr)
+        OnLoadProgress(this, read, job->mSize);
+}
+
+TextEditor::FileView::~FileView()
+{
+#ifdef _WIN32
+    if (mData != nullptr)
+        UnmapViewOfFile(mData);
+    if (mMapping != nullptr)
+        CloseHandle((HANDLE)mMapping);
+    if (mFile != nullptr)
+        CloseHandle((HANDLE)mFile);
+#else
+    if (mData != nullptr)
+        munmap((void*)mData, mSize);
+    if (mFile != -1)
+        close(mFile);
+#endif
+}
+
+bool TextEditor::OpenFileView(const std::string& aPath)
+{
+    auto view = std::make_shared<FileView>();
 
+#ifdef _WIN32
+    HANDLE file = CreateFileA(aPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    view->mFile = file;
 
-                    if (textLoc != std::string::npos) {
-                        curPos.mLine = curPos.mColumn = 0;
-                        int totalCount = 0;
-                        for (size_t ln = 0; ln < mLines.size(); ln++) {
-                            int lineCharCount = GetLineCharacterCount(ln) + 1;
-                            if (textLoc >= totalCount && textLoc < totalCount + lineCharCount) {
-                                curPos.mLine = ln;
-                                curPos.mColumn = textLoc - totalCount;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+        return false;
+    view->mSize = (size_t)size.QuadPart;
 
-                                auto& line = mLines[curPos.mLine];
-                                for (int i = 0; i < line.size(); i++)
-                                    if (line[i].mChar == '\t')
-                                        curPos.mColumn += (mTabSize - 1);
+    if (view->mSize > 0) {
+        view->mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (view->mMapping == nullptr)
+            return false;
+        view->mData = (const char*)MapViewOfFile((HANDLE)view->mMapping, FILE_MAP_READ, 0, 0, 0);
+        if (view->mData == nullptr)
+            return false;
+    }
+#else
+    view->mFile = open(aPath.c_str(), O_RDONLY);
+    if (view->mFile == -1)
+        return false;
 
-                                break;
-                            }
-                            totalCount += lineCharCount;
-                        }
+    struct stat info;
+    if (fstat(view->mFile, &info) != 0)
+        return false;
+    view->mSize = (size_t)info.st_size;
 
-                        auto selStart = curPos, selEnd = curPos;
-                        selEnd.mColumn += strlen(mFindWord);
-                        SetSelection(curPos, selEnd);
-                        DeleteSelection();
-                        InsertText(mReplaceWord);
-                        SetCursorPosition(selEnd);
-                        mScrollToCursor = true;
+    if (view->mSize > 0) {
+        void* data = mmap(nullptr, view->mSize, PROT_READ, MAP_PRIVATE, view->mFile, 0);
+        if (data == MAP_FAILED)
+            return false;
+        madvise(data, view->mSize, MADV_SEQUENTIAL);
+        view->mData = (const char*)data;
+    }
+#endif
 
-                        ImGui::SetKeyboardFocusHere(0);
+    CloseFileView();
+    SetText("");
 
-                        mReplaceIndex = textLoc + strlen(mReplaceWord);
-                    }
-                }
-            }
+    view->mIndex.push_back(0);
+    view->mLineCount = 1;
+    mFileView = view;
+    mFileViewScrollTo = 0;
+    mFileViewTopLine = 0;
 
-            ImGui::SameLine();
-            if (ImGui::Button((">>##replaceAll" + std::string(aTitle)).c_str())) {
-                if (strlen(mFindWord) > 0) {
-                    auto curPos = mState.mCursorPosition;
-
-                    std::string textSrc = GetText();
-                    size_t textLoc = textSrc.find(mFindWord, 0);
-
-                    do {
-                        if (textLoc != std::string::npos) {
-                            curPos.mLine = curPos.mColumn = 0;
-                            int totalCount = 0;
-                            for (size_t ln = 0; ln < mLines.size(); ln++) {
-                                int lineCharCount = GetLineCharacterCount(ln) + 1;
-                                if (textLoc >= totalCount && textLoc < totalCount + lineCharCount) {
-                                    curPos.mLine = ln;
-                                    curPos.mColumn = textLoc - totalCount;
-
-                                    auto& line = mLines[curPos.mLine];
-                                    for (int i = 0; i < line.size(); i++)
-                                        if (line[i].mChar == '\t')
-                                            curPos.mColumn += (mTabSize - 1);
+    std::thread(mIndexFileView, view).detach();
+    return true;
+}
 
-                                    break;
-                                }
-                                totalCount += lineCharCount;
-                            }
+void TextEditor::CloseFileView()
+{
+    if (mFileView == nullptr)
+        return;
 
+    CancelFileViewSearch();
+    mFileView->mCancel = true;
+    mFileView = nullptr;
+    mFileViewCache.clear();
+    mFileViewLines.clear();
+}
 
-                            auto selStart = curPos, selEnd = curPos;
-                            selEnd.mColumn += strlen(mFindWord);
-                            SetSelection(curPos, selEnd);
-                            DeleteSelection();
-                            InsertText(mReplaceWord);
-                            SetCursorPosition(selEnd);
-                            mScrollToCursor = true;
+int64_t TextEditor::GetFileViewLineCount() const
+{
+    if (mFileView == nullptr)
+        return 0;
 
-                            ImGui::SetKeyboardFocusHere(0);
+    std::lock_guard<std::mutex> lock(mFileView->mMutex);
+    return mFileView->mLineCount;
+}
 
-                            // find next occurance
-                            textSrc = GetText();
-                            textLoc += strlen(mReplaceWord);
-                            textLoc = textSrc.find(mFindWord, textLoc);
-                        }
-                    } while (textLoc != std::string::npos);
-                }
+void TextEditor::mIndexFileView(std::shared_ptr<FileView> aView)
+{
+    const size_t chunkSize = 16 << 20;
+    const char* data = aView->mData;
+    const char* end = data + aView->mSize;
+
+    std::vector<size_t> index;
+    int64_t lineCount = 1;
+    for (const char* text = data; text < end; ) {
+        if (aView->mCancel)
+            return;
+
+        // every FileViewIndexStep-th line start goes to the index
+        const char* chunkEnd = text + std::min<size_t>(chunkSize, end - text);
+        while (true) {
+            auto next = (const char*)memchr(text, '\n', chunkEnd - text);
+            if (next == nullptr) {
+                text = chunkEnd;
+                break;
             }
+
+            text = next + 1;
+            if (lineCount % FileViewIndexStep == 0)
+                index.push_back(text - data);
+            lineCount++;
         }
 
-        ImGui::EndChild();
+        std::lock_guard<std::mutex> lock(aView->mMutex);
+        aView->mIndex.insert(aView->mIndex.end(), index.begin(), index.end());
+        aView->mLineCount = lineCount;
+        index.clear();
+    }
 
-        ImGui::PushFont(font);
+    std::lock_guard<std::mutex> lock(aView->mMutex);
+    aView->mIndexed = true;
+}
 
-        if (ImGui::IsKeyPressed(ImGuiKey_Escape))
-            mFindOpened = false;
+size_t TextEditor::GetFileViewLineOffset(int64_t aLine) const
+{
+    size_t offset;
+    {
+        std::lock_guard<std::mutex> lock(mFileView->mMutex);
+        if (aLine < 0 || aLine >= mFileView->mLineCount || (size_t)(aLine / FileViewIndexStep) >= mFileView->mIndex.size())
+            return mFileView->mSize;
+        offset = mFileView->mIndex[(size_t)(aLine / FileViewIndexStep)];
     }
 
-    /* DEBUGGER CONTROLS */
-    if (IsDebugging() && mDebugBar)
-    {
-        ImFont* font = ImGui::GetFont();
-        ImGui::PopFont();
+    const char* data = mFileView->mData;
+    const char* end = data + mFileView->mSize;
+    for (int64_t i = 0; i < aLine % FileViewIndexStep; i++) {
+        auto next = offset < mFileView->mSize ? (const char*)memchr(data + offset, '\n', end - data - offset) : nullptr;
+        if (next == nullptr)
+            return mFileView->mSize;
+        offset = next - data + 1;
+    }
+    return offset;
+}
 
+const TextEditor::Line& TextEditor::GetFileViewLine(int64_t aLine)
+{
+    auto cached = mFileViewLines.find(aLine);
+    if (cached != mFileViewLines.end()) {
+        mFileViewCache.splice(mFileViewCache.begin(), mFileViewCache, cached->second);
+        return cached->second->second;
+    }
 
-        ImGui::SetNextWindowPos(ImVec2(mFindOrigin.x + windowWidth / 2 - mDebugBarWidth / 2, mFindOrigin.y), ImGuiCond_Always);
-        ImGui::BeginChild(("##ted_dbgcontrols" + std::string(aTitle)).c_str(), ImVec2(mDebugBarWidth, mDebugBarHeight), true, ImGuiWindowFlags_NoScrollbar);
+    // decode and colorize the line, evicting the least recently used one
+    if (mFileViewCache.size() >= FileViewCacheSize) {
+        mFileViewLines.erase(mFileViewCache.back().first);
+        mFileViewCache.pop_back();
+    }
+    mFileViewCache.emplace_front(aLine, Line());
+    mFileViewLines[aLine] = mFileViewCache.begin();
+    auto& line = mFileViewCache.front().second;
+
+    size_t offset = GetFileViewLineOffset(aLine);
+    const char* text = mFileView->mData + offset;
+    size_t size = mFileView->mSize - offset;
+    auto next = size > 0 ? (const char*)memchr(text, '\n', size) : nullptr;
+    if (next != nullptr)
+        size = next - text;
+
+    // the index only scopes folds and function locals, which the file view doesn't have
+    int index = (int)std::min<int64_t>(aLine, std::numeric_limits<int>::max());
+    std::vector<Coordinates> foldBegin, foldEnd;
+    BuildLine(line, index, text, size, mTabSize, foldBegin, foldEnd);
+
+    if (mColorizerEnabled) {
+        std::string buffer, id;
+        std::cmatch results;
+        ColorizeLine(line, index, buffer, results, id);
+
+        // comments can't span lines here, there is no state from the previous lines
+        for (auto& comment : mLanguageDefinition.single_line_comments) {
+            auto start = buffer.find(comment);
+            if (!comment.empty() && start != std::string::npos)
+                for (size_t i = start; i < line.size(); i++)
+                    line[i].mComment = true;
+        }
+    }
 
-        ImVec2 dbBarStart = ImGui::GetCursorPos();
+    return line;
+}
 
-        if (ImGui::Button(("Step##ted_dbgstep" + std::string(aTitle)).c_str()) && OnDebuggerAction)
-            OnDebuggerAction(this, DebugAction::Step);
-        ImGui::SameLine(0, 6);
+bool TextEditor::FindInFileView(const std::string& aText, int64_t aFromLine)
+{
+    CancelFileViewSearch();
+    if (mFileView == nullptr || aText.empty() || aFromLine >= GetFileViewLineCount())
+        return false;
 
-        if (ImGui::Button(("Step In##ted_dbgstepin" + std::string(aTitle)).c_str()) && OnDebuggerAction)
-            OnDebuggerAction(this, DebugAction::StepInto);
-        ImGui::SameLine(0, 6);
+    auto job = std::make_shared<FileViewSearch>();
+    job->mView = mFileView;
+    job->mText = aText;
+    job->mFromLine = std::max<int64_t>(0, aFromLine);
+    job->mOffset = GetFileViewLineOffset(job->mFromLine);
+    mFileViewSearch = job;
 
-        if (ImGui::Button(("Step Out##ted_dbgstepout" + std::string(aTitle)).c_str()) && OnDebuggerAction)
-            OnDebuggerAction(this, DebugAction::StepOut);
-        ImGui::SameLine(0, 6);
+    std::thread(mRunFileViewSearch, job).detach();
+    return true;
+}
 
-        if (ImGui::Button(("Continue##ted_dbgcontinue" + std::string(aTitle)).c_str()) && OnDebuggerAction)
-            OnDebuggerAction(this, DebugAction::Continue);
-        ImGui::SameLine(0, 6);
+void TextEditor::CancelFileViewSearch()
+{
+    if (mFileViewSearch == nullptr)
+        return;
 
-        if (ImGui::Button(("Stop##ted_dbgstop" + std::string(aTitle)).c_str()) && OnDebuggerAction)
-            OnDebuggerAction(this, DebugAction::Stop);
+    mFileViewSearch->mCancel = true;
+    mFileViewSearch = nullptr;
+}
 
-        ImVec2 dbBarEnd = ImGui::GetCursorPos();
-        mDebugBarHeight = dbBarEnd.y - dbBarStart.y + ImGui::GetStyle().WindowPadding.y * 2.0f;
+void TextEditor::mRunFileViewSearch(std::shared_ptr<FileViewSearch> aJob)
+{
+    const size_t chunkSize = 16 << 20;
+    const char* data = aJob->mView->mData;
+    const char* end = data + aJob->mView->mSize;
+    const auto& what = aJob->mText;
+
+    int64_t line = aJob->mFromLine;
+    int64_t found = -1;
+    for (const char* text = data + aJob->mOffset; text < end; ) {
+        if (aJob->mCancel || aJob->mView->mCancel)
+            return;
 
-        ImGui::SameLine(0, 6);
+        // a match starts inside the chunk but may end past it
+        const char* chunkEnd = text + std::min<size_t>(chunkSize, end - text);
+        const char* searchEnd = chunkEnd + std::min<size_t>(what.size() - 1, end - chunkEnd);
+        const char* match = std::search(text, searchEnd, what.begin(), what.end());
+        if (match != searchEnd) {
+            found = line + (int64_t)std::count(text, match, '\n');
+            break;
+        }
 
-        dbBarEnd = ImGui::GetCursorPos();
-        mDebugBarWidth = dbBarEnd.x - dbBarStart.x + ImGui::GetStyle().WindowPadding.x * 2.0f;
+        line += (int64_t)std::count(text, chunkEnd, '\n');
+        text = chunkEnd;
+    }
 
-        ImGui::EndChild();
+    std::lock_guard<std::mutex> lock(aJob->mMutex);
+    aJob->mLine = found;
+    aJob->mDone = true;
+}
 
-        ImGui::PushFont(font);
+void TextEditor::mUpdateFileViewSearch()
+{
+    auto job = mFileViewSearch;
+    if (job == nullptr)
+        return;
+
+    int64_t line;
+    {
+        std::lock_guard<std::mutex> lock(job->mMutex);
+        if (!job->mDone)
+            return;
+        line = job->mLine;
     }
+    mFileViewSearch = nullptr;
+
+    if (line >= 0)
+        mFileViewScrollTo = line;
+    if (OnFileViewFind != nullptr)
+        OnFileViewFind(this, line);
+}
 
+void TextEditor::RenderFileView(const char* aTitle, const ImVec2& aSize, bool aBorder)
+{
+    int64_t lineCount = GetFileViewLineCount();
+
+    ImGui::PushStyleColor(ImGuiCol_ChildBg, ImGui::ColorConvertU32ToFloat4(mPalette[(int)PaletteIndex::Background]));
+    ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 0.0f));
     if (!mIgnoreImGuiChild)
-        ImGui::EndChild();
-    ImGui::PopStyleColor();
-    ImGui::PopStyleVar();
+        ImGui::BeginChild(aTitle, aSize, aBorder, (ImGuiWindowFlags_AlwaysHorizontalScrollbar * mHorizontalScroll) | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoNav);
 
-    // breakpoint condition popup
-    if (openBkptConditionWindow)
-        ImGui::OpenPopup("Condition##condition");
+    const float fontSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, "#", nullptr, nullptr).x;
+    const float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+    mCharAdvance = ImVec2(fontSize, ImGui::GetTextLineHeightWithSpacing() * mLineSpacing);
 
-    ImFont* font = ImGui::GetFont();
-    ImGui::PopFont();
-    ImGui::SetNextWindowSize(ImVec2(430, 175), ImGuiCond_Once);
-    if (ImGui::BeginPopupModal("Condition##condition")) {
-        ImGui::Checkbox("Use condition", &mPopupCondition_Use);
+    for (int i = 0; i < (int)PaletteIndex::Max; ++i) {
+        auto color = ImGui::ColorConvertU32ToFloat4(mPaletteBase[i]);
+        color.w *= ImGui::GetStyle().Alpha;
+        mPalette[i] = ImGui::ColorConvertFloat4ToU32(color);
+    }
 
-        if (!mPopupCondition_Use) {
-            ImGui::PushItemFlag(ImGuiItemFlags_Disabled, true);
-            ImGui::PushStyleVar(ImGuiStyleVar_Alpha, ImGui::GetStyle().Alpha * 0.5f);
-        }
-        ImGui::InputText("Condition", mPopupCondition_Condition, 512);
-        if (!mPopupCondition_Use) {
-            ImGui::PopStyleVar();
-            ImGui::PopItemFlag();
-        }
+    // the vertical position is kept in lines and only the visible lines are laid out, the window
+    // itself never scrolls vertically
+    auto drawList = ImGui::GetWindowDrawList();
+    ImGuiWindow* window = ImGui::GetCurrentWindowRead();
+    float height = ImGui::GetContentRegionAvail().y;
+    int visibleLines = std::max<int>(1, (int)floor(height / mCharAdvance.y));
+    int64_t maxTopLine = std::max<int64_t>(0, lineCount - visibleLines);
+
+    if (mFileViewScrollTo >= 0 && mFileViewScrollTo < lineCount) {
+        mFileViewTopLine = mFileViewScrollTo;
+        mFileViewScrollTo = -1;
+    }
+    if (ImGui::IsWindowHovered() && ImGui::GetIO().MouseWheel != 0.0f && !ImGui::GetIO().KeyCtrl)
+        mFileViewTopLine -= (int)(ImGui::GetIO().MouseWheel * std::min<int>(5, std::max<int>(1, visibleLines * 2 / 3)));
+    mFileViewTopLine = std::max<int64_t>(0, std::min<int64_t>(mFileViewTopLine, maxTopLine));
+
+    float scrollbarWidth = 0.0f;
+    if (maxTopLine > 0) {
+        scrollbarWidth = ImGui::GetStyle().ScrollbarSize;
+        ImRect scrollbar;
+        scrollbar.Min = ImVec2(window->InnerRect.Max.x - scrollbarWidth, window->InnerRect.Min.y);
+        scrollbar.Max = window->InnerRect.Max;
+
+        ImS64 topLine = mFileViewTopLine;
+        ImGui::ScrollbarEx(scrollbar, ImGui::GetID("##fileview_scrollbar"), ImGuiAxis_Y, &topLine, visibleLines, lineCount, ImDrawFlags_RoundCornersNone);
+        mFileViewTopLine = topLine;
+    }
+    ImGui::PushClipRect(window->InnerClipRect.Min, ImVec2(window->InnerClipRect.Max.x - scrollbarWidth, window->InnerClipRect.Max.y), true);
 
-        if (ImGui::Button("Cancel"))
-            ImGui::CloseCurrentPopup();
-        ImGui::SameLine();
-        if (ImGui::Button("OK")) {
-            size_t clen = strlen(mPopupCondition_Condition);
-            bool isEmpty = true;
-            for (size_t i = 0; i < clen; i++)
-                if (!isspace(mPopupCondition_Condition[i])) {
-                    isEmpty = false;
-                    break;
-                }
-            Breakpoint& bkpt = GetBreakpoint(mPopupCondition_Line);
-            bkpt.mCondition = mPopupCondition_Condition;
-            bkpt.mUseCondition = (mPopupCondition_Use && !isEmpty);
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float scrollX = ImGui::GetScrollX();
 
-            if (OnBreakpointUpdate)
-                OnBreakpointUpdate(this, bkpt.mLine, bkpt.mUseCondition, bkpt.mCondition, bkpt.mEnabled);
+    char buf[32];
+    snprintf(buf, 32, " %3lld ", (long long)lineCount);
+    mTextStart = (ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x + mLeftMargin) * mSidebar;
 
-            ImGui::CloseCurrentPopup();
+    // only the visible lines are decoded
+    int64_t lineNo = mFileViewTopLine;
+    int64_t lineMax = std::min<int64_t>(lineCount, lineNo + (int64_t)ceil(height / mCharAdvance.y));
+    float longest = mTextStart;
+    for (; lineNo < lineMax; lineNo++) {
+        ImVec2 lineStartScreenPos(origin.x, origin.y + (float)(lineNo - mFileViewTopLine) * mCharAdvance.y);
+        ImVec2 textScreenPos(lineStartScreenPos.x + mTextStart, lineStartScreenPos.y);
+        auto& line = GetFileViewLine(lineNo);
+
+        auto prevColor = line.empty() ? mPalette[(int)PaletteIndex::Default] : GetGlyphColor(line[0]);
+        float offset = 0.0f;
+        for (int i = 0; i < (int)line.size();) {
+            auto& glyph = line[i];
+            auto color = GetGlyphColor(glyph);
+
+            if ((color != prevColor || glyph.mChar == '\t' || glyph.mChar == ' ') && !mLineBuffer.empty()) {
+                drawList->AddText(ImVec2(textScreenPos.x + offset, textScreenPos.y), prevColor, mLineBuffer.c_str());
+                offset += ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, mLineBuffer.c_str(), nullptr, nullptr).x;
+                mLineBuffer.clear();
+            }
+            prevColor = color;
+
+            if (glyph.mChar == '\t') {
+                offset = (1.0f + std::floor((1.0f + offset) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
+                i++;
+            } else if (glyph.mChar == ' ') {
+                offset += spaceSize;
+                i++;
+            } else {
+                auto l = UTF8CharLength(glyph.mChar);
+                while (l-- > 0 && i < (int)line.size())
+                    mLineBuffer.push_back(line[i++].mChar);
+            }
         }
-        ImGui::EndPopup();
-    }
-    ImGui::PushFont(font);
-
-    mWithinRender = false;
-}
+        if (!mLineBuffer.empty()) {
+            drawList->AddText(ImVec2(textScreenPos.x + offset, textScreenPos.y), prevColor, mLineBuffer.c_str());
+            offset += ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, mLineBuffer.c_str(), nullptr, nullptr).x;
+            mLineBuffer.clear();
+        }
+        longest = std::max(longest, mTextStart + offset);
 
-void TextEditor::SetText(const std::string & aText)
-{
-    mLines.clear();
-    mFoldBegin.clear();
-    mFoldEnd.clear();
-    mFoldSorted = false;
+        // side bar
+        if (mSidebar) {
+            drawList->AddRectFilled(ImVec2(lineStartScreenPos.x + scrollX, lineStartScreenPos.y), ImVec2(lineStartScreenPos.x + scrollX + mTextStart - 5.0f, lineStartScreenPos.y + mCharAdvance.y), ImGui::GetColorU32(ImGuiCol_WindowBg));
 
-    mLines.emplace_back(Line());
-    for (auto chr : aText)
-    {
-        if (chr == '\r') {
-            // ignore the carriage return character
-        } else if (chr == '\n')
-            mLines.emplace_back(Line());
-        else {
-            if (chr == '{')
-                mFoldBegin.push_back(Coordinates(mLines.size() - 1, mLines.back().size()));
-            else if (chr == '}')
-                mFoldEnd.push_back(Coordinates(mLines.size() - 1, mLines.back().size()));
+            if (mShowLineNumbers) {
+                snprintf(buf, 32, "%3lld  ", (long long)(lineNo + 1));
 
-            mLines.back().emplace_back(Glyph(chr, PaletteIndex::Default));
+                auto lineNoWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x;
+                drawList->AddText(ImVec2(lineStartScreenPos.x + scrollX + mTextStart - lineNoWidth, lineStartScreenPos.y), mPalette[(int)PaletteIndex::LineNumber], buf);
+            }
         }
     }
 
-    
-    mTextChanged = true;
-    mScrollToTop = true;
-
-    mUndoBuffer.clear();
-    mUndoIndex = 0;
+    ImGui::PopClipRect();
+    ImGui::Dummy(ImVec2(longest + mCharAdvance.x + scrollbarWidth, height));
 
-    Colorize();
+    if (!mIgnoreImGuiChild)
+        ImGui::EndChild();
+    ImGui::PopStyleVar();
+    ImGui::PopStyleColor();
 }
 
 void TextEditor::SetTextLines(const std::vector<std::string> & aLines)
 {
-    mLines.clear();
-    mFoldBegin.clear();
-    mFoldEnd.clear();
-    mFoldSorted = false;
-
-    if (aLines.empty())
-    {
-        mLines.emplace_back(Line());
-    }
-    else
-    {
-        mLines.resize(aLines.size());
+    assert(mEditDepth == 0);
 
-        for (size_t i = 0; i < aLines.size(); ++i)
-        {
-            const std::string & aLine = aLines[i];
+    Coordinates oldEnd;
+    if (WantsTextChanges() && !mLines.empty())
+        oldEnd = Coordinates((int)mLines.size() - 1, (int)mLines.back().size());
 
-            mLines[i].reserve(aLine.size());
-            for (size_t j = 0; j < aLine.size(); ++j) {
-                if (aLine[j] == '{')
-                    mFoldBegin.push_back(Coordinates(i, j));
-                else if (aLine[j] == '}')
-                    mFoldEnd.push_back(Coordinates(i, j));
+    std::vector<std::pair<const char*, size_t>> lines;
+    lines.reserve(aLines.size());
+    for (auto& line : aLines)
+        lines.emplace_back(line.data(), line.size());
 
-                mLines[i].emplace_back(Glyph(aLine[j], PaletteIndex::Default));
-            }
-        }
-    }
+    LoadLines(lines);
 
     mTextChanged = true;
+    mTextVersion++;
+    mSeenTextVersion = mTextVersion;
     mScrollToTop = true;
 
     mUndoBuffer.clear();
     mUndoIndex = 0;
 
+    if (WantsTextChanges())
+        AddTextChange(Coordinates(), oldEnd, GetText());
+
     Colorize();
 }
 
@@ -3897,6 +5923,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
             u.mRemoved = GetText(start, end);
 
             bool modified = false;
+            BeginViewRemap();
 
             for (int i = start.mLine; i <= end.mLine; i++)
             {
@@ -3956,12 +5983,13 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
                 mState.mSelectionEnd = end;
                 AddUndo(u);
 
-                mTextChanged = true;
-                if (OnContentUpdate != nullptr)
-                    OnContentUpdate(this);
+                MarkTextChanged();
+                AddTextChange(u.mRemovedStart, GetTextEndIndex(u.mRemovedStart, u.mRemoved), u.mAdded); // starts at column 0
+                Colorize(start.mLine, end.mLine - start.mLine + 1);
 
                 EnsureCursorVisible();
             }
+            EndViewRemap(); // in case nothing was indented
 
             return;
         }
@@ -3975,6 +6003,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
     }
 
     auto coord = GetActualCursorCoordinates();
+    int overwriteSize = 0;
     u.mAddedStart = coord;
 
     if (mLines.empty())
@@ -3982,6 +6011,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 
     if (aChar == '\n')
     {
+        BeginViewRemap();
         InsertLine(coord.mLine + 1, coord.mColumn);
         auto& line = mLines[coord.mLine];
         auto& newLine = mLines[coord.mLine + 1];
@@ -4026,6 +6056,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 
             auto& line = mLines[coord.mLine];
             auto cindex = GetCharacterIndex(coord);
+            BeginViewRemap();
 
             if (mOverwrite && cindex < (int)line.size())
             {
@@ -4033,6 +6064,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 
                 u.mRemovedStart = mState.mCursorPosition;
                 u.mRemovedEnd = Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex + d));
+                overwriteSize = std::min<int>(d, (int)line.size() - cindex);
 
                 while (d-- > 0 && cindex < (int)line.size())
                 {
@@ -4109,11 +6141,13 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
             mChangedLines.push_back(mState.mCursorPosition.mLine);
     }
 
-    mTextChanged = true;
-    if (OnContentUpdate != nullptr)
-        OnContentUpdate(this);
+    MarkTextChanged();
 
     u.mAddedEnd = GetActualCursorCoordinates();
+    if (WantsTextChanges()) {
+        Coordinates changeStart(coord.mLine, GetCharacterIndex(coord));
+        AddTextChange(changeStart, Coordinates(coord.mLine, changeStart.mColumn + overwriteSize), GetText(coord, u.mAddedEnd));
+    }
     u.mAfter = mState;
 
     AddUndo(u);
@@ -4252,24 +6286,147 @@ void TextEditor::SetSelection(const Coordinates & aStart, const Coordinates & aE
     if (mState.mSelectionStart != oldSelStart ||
         mState.mSelectionEnd != oldSelEnd)
         mCursorPositionChanged = true;
+}
+
+void TextEditor::InsertText(const std::string& aValue, bool indent)
+{
+    InsertText(aValue.c_str(), indent);
+}
+
+void TextEditor::InsertText(const char* aValue, bool indent)
+{
+    if (aValue == nullptr)
+        return;
+
+    if (mEditDepth == 0) {
+        InsertTextInternal(aValue, indent);
+        return;
+    }
+
+    // inside a batch the insertion becomes a part of its undo step
+    UndoRecord u;
+    u.mBefore = mState;
+    u.mAddedStart = GetActualCursorCoordinates();
+
+    InsertTextInternal(aValue, indent);
+
+    u.mAddedEnd = GetActualCursorCoordinates();
+    u.mAdded = GetText(u.mAddedStart, u.mAddedEnd);
+    u.mAfter = mState;
+    AddUndo(u);
+}
+
+void TextEditor::AppendText(const std::string& aText)
+{
+    AppendText(aText.data(), aText.size());
+}
+
+void TextEditor::AppendText(const char* aText, size_t aSize)
+{
+    assert(mEditDepth == 0);
+    if (aText == nullptr || aSize == 0)
+        return;
+
+    if (mLines.empty())
+        mLines.push_back(Line());
+
+    int last = (int)mLines.size() - 1;
+    Coordinates start(last, (int)mLines[last].size());
+
+    // the first segment continues the last line, which is rebuilt together with its folds
+    const char* end = aText + aSize;
+    const char* next = (const char*)memchr(aText, '\n', aSize);
+    const char* segmentEnd = next == nullptr ? end : next;
+
+    std::string lastLine;
+    lastLine.reserve(mLines[last].size() + (segmentEnd - aText));
+    for (auto& glyph : mLines[last])
+        lastLine += glyph.mChar;
+    lastLine.append(aText, segmentEnd);
+
+    auto onLastLine = [last](const Coordinates& aFold) { return aFold.mLine == last; };
+    mFoldBegin.erase(std::remove_if(mFoldBegin.begin(), mFoldBegin.end(), onLastLine), mFoldBegin.end());
+    mFoldEnd.erase(std::remove_if(mFoldEnd.begin(), mFoldEnd.end(), onLastLine), mFoldEnd.end());
+    mLines[last].clear();
+    BuildLine(mLines[last], last, lastLine.data(), lastLine.size(), mTabSize, mFoldBegin, mFoldEnd);
+
+    while (next != nullptr) {
+        const char* text = next + 1;
+        next = (const char*)memchr(text, '\n', end - text);
+        segmentEnd = next == nullptr ? end : next;
+
+        mLines.emplace_back();
+        BuildLine(mLines.back(), (int)mLines.size() - 1, text, segmentEnd - text, mTabSize, mFoldBegin, mFoldEnd);
+    }
+    mFoldSorted = false;
+
+    MarkTextChanged();
+    if (WantsTextChanges())
+        AddTextChange(start, start, std::string(aText, aSize));
+
+    // only the appended lines are colorized, the comment scan resumes from the previous last line
+    int tail = std::max<int>(0, mTailCommentLine);
+    mCommentScanFrom = mCheckComments ? std::min<int>(mCommentScanFrom, tail) : tail;
+    mCheckComments = true;
+    mColorRangeMin = std::max<int>(0, std::min<int>(mColorRangeMin, last));
+    mColorRangeMax = std::max<int>(mColorRangeMax, (int)mLines.size());
+    InvalidateSnapshotLines(last, (int)mLines.size());
+
+    // drop a quarter of the limit at once so that trimming stays O(1) amortized per line
+    if (mMaxLineCount > 0 && (int)mLines.size() > mMaxLineCount)
+        DropFrontLines((int)mLines.size() - (mMaxLineCount - mMaxLineCount / 4));
+
+    if (mAutoScroll && mPinnedToBottom)
+        mScrollToBottom = true;
+}
+
+void TextEditor::DropFrontLines(int aCount)
+{
+    assert(aCount > 0 && aCount < (int)mLines.size());
+
+    mLines.erase(mLines.begin(), mLines.begin() + aCount);
+
+    auto dropFolds = [aCount](std::vector<Coordinates>& aFolds) {
+        size_t count = 0;
+        for (auto& fold : aFolds)
+            if (fold.mLine >= aCount)
+                aFolds[count++] = Coordinates(fold.mLine - aCount, fold.mColumn);
+        aFolds.resize(count);
+    };
+    dropFolds(mFoldBegin);
+    dropFolds(mFoldEnd);
+    mFoldSorted = false;
+
+    // error markers, breakpoints and scrollbar markers
+    ShiftLines(0, -aCount);
+
+    auto shift = [aCount](Coordinates& aPosition) {
+        aPosition = aPosition.mLine < aCount ? Coordinates() : Coordinates(aPosition.mLine - aCount, aPosition.mColumn);
+    };
+    shift(mState.mCursorPosition);
+    shift(mState.mSelectionStart);
+    shift(mState.mSelectionEnd);
+    shift(mInteractiveStart);
+    shift(mInteractiveEnd);
+
+    // the first remaining line starts a new document for the comment scan
+    mTailCommentLine = mTailCommentLine >= aCount ? mTailCommentLine - aCount : -1;
+    mCommentScanFrom = mCommentScanFrom >= aCount ? mCommentScanFrom - aCount : 0;
+    if (mColorRangeMin < mColorRangeMax) {
+        mColorRangeMin = std::max<int>(0, mColorRangeMin - aCount);
+        mColorRangeMax = std::max<int>(mColorRangeMin, mColorRangeMax - aCount);
+    }
 
-    // update mReplaceIndex
-    mReplaceIndex = 0;
-    for (size_t ln = 0; ln < mState.mCursorPosition.mLine; ln++)
-        mReplaceIndex += GetLineCharacterCount(ln) + 1;
-    mReplaceIndex += mState.mCursorPosition.mColumn;
-}
+    // undo records point into the dropped lines
+    mUndoBuffer.clear();
+    mUndoIndex = 0;
 
-void TextEditor::InsertText(const std::string& aValue, bool indent)
-{
-    InsertText(aValue.c_str(), indent);
+    if (WantsTextChanges())
+        AddTextChange(Coordinates(), Coordinates(aCount, 0), std::string());
 }
 
-void TextEditor::InsertText(const char* aValue, bool indent)
+void TextEditor::InsertTextInternal(const char* aValue, bool indent)
 {
-    if (aValue == nullptr)
-        return;
-
     auto pos = GetActualCursorCoordinates();
     auto start = std::min<Coordinates>(pos, mState.mSelectionStart);
     int totalLines = pos.mLine - start.mLine;
@@ -4281,6 +6438,152 @@ void TextEditor::InsertText(const char* aValue, bool indent)
     Colorize(start.mLine - 1, totalLines + 2);
 }
 
+bool TextEditor::ApplyEdits(std::vector<TextEdit> aEdits)
+{
+    assert(!mReadOnly);
+
+    if (aEdits.empty() || mLines.empty())
+        return true;
+
+    std::stable_sort(aEdits.begin(), aEdits.end(), [](const TextEdit& a, const TextEdit& b) {
+        return a.mStart < b.mStart;
+    });
+
+    // edit ranges in glyph indices (mColumn holds the index into the line), mAddedEnd is where the
+    // inserted text ends once the edits that follow it in the document have been applied
+    struct Span {
+        Coordinates mStart, mEnd, mAddedEnd;
+    };
+    std::vector<Span> spans(aEdits.size());
+    for (size_t i = 0; i < aEdits.size(); i++) {
+        auto& edit = aEdits[i];
+        auto& span = spans[i];
+
+        edit.mStart = SanitizeCoordinates(edit.mStart);
+        edit.mEnd = SanitizeCoordinates(edit.mEnd);
+
+        span.mStart = Coordinates(edit.mStart.mLine, GetCharacterIndex(edit.mStart));
+        span.mEnd = Coordinates(edit.mEnd.mLine, GetCharacterIndex(edit.mEnd));
+
+        // the edits come from formatters and language servers, a bad set is rejected before anything is changed
+        if (span.mEnd < span.mStart || (i > 0 && span.mStart < spans[i - 1].mEnd))
+            return false;
+        edit.mStart.mColumn = GetCharacterColumn(span.mStart.mLine, span.mStart.mColumn);
+        edit.mEnd.mColumn = GetCharacterColumn(span.mEnd.mLine, span.mEnd.mColumn);
+
+        span.mAddedEnd = span.mStart;
+        for (char c : edit.mText) {
+            if (c == '\n') {
+                span.mAddedEnd.mLine++;
+                span.mAddedEnd.mColumn = 0;
+            } else if (c != '\r')
+                span.mAddedEnd.mColumn++;
+        }
+    }
+
+    // cursor and selection, remapped back to front so that every edit sees the positions it shifted
+    auto remap = [&](const Coordinates& aValue) {
+        auto value = SanitizeCoordinates(aValue);
+        Coordinates pos(value.mLine, GetCharacterIndex(value));
+        for (size_t i = spans.size(); i-- > 0;) {
+            auto& span = spans[i];
+            if (pos <= span.mStart)
+                continue;
+
+            if (pos < span.mEnd)
+                pos = span.mAddedEnd;
+            else if (pos.mLine == span.mEnd.mLine)
+                pos = Coordinates(span.mAddedEnd.mLine, span.mAddedEnd.mColumn + pos.mColumn - span.mEnd.mColumn);
+            else
+                pos.mLine += (span.mAddedEnd.mLine - span.mStart.mLine) - (span.mEnd.mLine - span.mStart.mLine);
+        }
+        return pos;
+    };
+    auto cursor = remap(mState.mCursorPosition);
+    auto selectionStart = remap(mState.mSelectionStart);
+    auto selectionEnd = remap(mState.mSelectionEnd);
+
+    // undo records are replayed back to front as well, which keeps their coordinates valid
+    std::vector<UndoRecord> records(aEdits.size());
+    for (size_t i = 0; i < aEdits.size(); i++) {
+        auto& edit = aEdits[i];
+        auto& u = records[i];
+        u.mRemoved = GetText(edit.mStart, edit.mEnd);
+        u.mRemovedStart = edit.mStart;
+        u.mRemovedEnd = edit.mEnd;
+        u.mAdded = edit.mText;
+        u.mAddedStart = edit.mStart;
+        u.mAddedEnd = GetTextEnd(edit.mStart, edit.mText);
+        u.mBefore = u.mAfter = mState;
+    }
+
+    BeginEdit();
+    BeginViewRemap();
+
+    // rebuild the lines in a single pass, untouched lines are moved as a whole
+    std::vector<Line> lines;
+    lines.reserve(mLines.size());
+    Line current;
+    Coordinates from;
+    auto copyUntil = [&](const Coordinates& aTo) {
+        for (; from.mLine < aTo.mLine; from.mLine++, from.mColumn = 0) {
+            auto& line = mLines[from.mLine];
+            if (current.empty() && from.mColumn == 0)
+                lines.push_back(std::move(line));
+            else {
+                current.insert(current.end(), line.begin() + from.mColumn, line.end());
+                lines.push_back(std::move(current));
+            }
+            current = Line();
+        }
+        if (aTo.mLine < (int)mLines.size()) {
+            auto& line = mLines[aTo.mLine];
+            current.insert(current.end(), line.begin() + from.mColumn, line.begin() + aTo.mColumn);
+        }
+    };
+    for (size_t i = 0; i < aEdits.size(); i++) {
+        copyUntil(spans[i].mStart);
+        for (char c : aEdits[i].mText) {
+            if (c == '\n') {
+                lines.push_back(std::move(current));
+                current = Line();
+            } else if (c != '\r')
+                current.emplace_back(Glyph(c, PaletteIndex::Default));
+        }
+        from = spans[i].mEnd;
+    }
+    copyUntil(Coordinates((int)mLines.size(), 0));
+    mLines = std::move(lines);
+
+    mState.mCursorPosition = Coordinates(cursor.mLine, GetCharacterColumn(cursor.mLine, cursor.mColumn));
+    mState.mSelectionStart = Coordinates(selectionStart.mLine, GetCharacterColumn(selectionStart.mLine, selectionStart.mColumn));
+    mState.mSelectionEnd = Coordinates(selectionEnd.mLine, GetCharacterColumn(selectionEnd.mLine, selectionEnd.mColumn));
+
+    MarkTextChanged();
+
+    // line bookkeeping, undo and change events in the order a back to front application would produce
+    for (size_t i = spans.size(); i-- > 0;) {
+        auto& span = spans[i];
+        int removed = span.mEnd.mLine - span.mStart.mLine;
+        int added = span.mAddedEnd.mLine - span.mStart.mLine;
+        if (removed > 0)
+            ShiftLines(span.mStart.mLine + 1, -removed);
+        if (added > 0)
+            ShiftLines(span.mStart.mLine + 1, added);
+        mEditLineMin = std::min<int>(mEditLineMin, span.mStart.mLine);
+        mEditLineMax = std::max<int>(mEditLineMax, span.mStart.mLine + added + 1);
+
+        if (records[i].mRemoved.empty() && records[i].mAdded.empty())
+            continue;
+
+        AddUndo(records[i]);
+        AddTextChange(spans[i].mStart, spans[i].mEnd, aEdits[i].mText);
+    }
+
+    EndEdit();
+    return true;
+}
+
 void TextEditor::DeleteSelection()
 {
     assert(mState.mSelectionEnd >= mState.mSelectionStart);
@@ -4349,11 +6652,6 @@ void TextEditor::MoveDown(int aAmount, bool aSelect)
     }
 }
 
-static bool IsUTFSequence(char c)
-{
-    return (c & 0xC0) == 0x80;
-}
-
 void TextEditor::MoveLeft(int aAmount, bool aSelect, bool aWordMode)
 {
     if (mLines.empty())
@@ -4584,6 +6882,8 @@ void TextEditor::Delete()
     else
     {
         auto pos = GetActualCursorCoordinates();
+        Coordinates changeStart(pos.mLine, GetCharacterIndex(pos));
+        auto changeEnd = changeStart;
         SetCursorPosition(pos);
         auto& line = mLines[pos.mLine];
 
@@ -4592,9 +6892,11 @@ void TextEditor::Delete()
             if (pos.mLine == (int)mLines.size() - 1)
                 return;
 
+            BeginViewRemap();
             u.mRemoved = '\n';
             u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
             Advance(u.mRemovedEnd);
+            changeEnd = u.mRemovedEnd;
 
             // move folds
             for (int i = 0; i < mFoldBegin.size(); i++)
@@ -4624,6 +6926,8 @@ void TextEditor::Delete()
             mRemoveFolds(u.mRemovedStart, u.mRemovedEnd);
 
             auto d = UTF8CharLength(line[cindex].mChar);
+            changeEnd = Coordinates(pos.mLine, std::min<int>(cindex + d, (int)line.size()));
+            BeginViewRemap();
             while (d-- > 0 && cindex < (int)line.size())
                 line.erase(line.begin() + cindex);
         }
@@ -4640,9 +6944,8 @@ void TextEditor::Delete()
                 mChangedLines.push_back(mState.mCursorPosition.mLine);
         }
 
-        mTextChanged = true;
-        if (OnContentUpdate != nullptr)
-            OnContentUpdate(this);
+        MarkTextChanged();
+        AddTextChange(changeStart, changeEnd, std::string());
 
         Colorize(pos.mLine, 1);
     }
@@ -4672,6 +6975,7 @@ void TextEditor::Backspace()
     else
     {
         auto pos = GetActualCursorCoordinates();
+        Coordinates changeStart;
         SetCursorPosition(pos);
 
         if (mState.mCursorPosition.mColumn == 0)
@@ -4679,6 +6983,8 @@ void TextEditor::Backspace()
             if (mState.mCursorPosition.mLine == 0)
                 return;
 
+            changeStart = Coordinates(pos.mLine - 1, (int)mLines[pos.mLine - 1].size());
+            BeginViewRemap();
             u.mRemoved = '\n';
             u.mRemovedStart = u.mRemovedEnd = Coordinates(pos.mLine - 1, GetLineMaxColumn(pos.mLine - 1));
             Advance(u.mRemovedEnd);
@@ -4731,6 +7037,8 @@ void TextEditor::Backspace()
             }
 
             u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
+            changeStart = Coordinates(pos.mLine, cindex);
+            BeginViewRemap();
 
             while (cindex < line.size() && cend-- > cindex) {
                 uint8_t chVal = line[cindex].mChar;
@@ -4768,9 +7076,8 @@ void TextEditor::Backspace()
                 mChangedLines.push_back(mState.mCursorPosition.mLine);
         }
 
-        mTextChanged = true;
-        if (OnContentUpdate != nullptr)
-            OnContentUpdate(this);
+        MarkTextChanged();
+        AddTextChange(changeStart, GetTextEndIndex(changeStart, u.mRemoved), std::string());
 
         EnsureCursorVisible();
         Colorize(mState.mCursorPosition.mLine, 1);
@@ -4811,6 +7118,92 @@ void TextEditor::SetShortcut(ShortcutID id, Shortcut s) {
         m_shortcuts[(int)id].Shift = s.Shift;
     if (m_shortcuts[(int)id].Alt != 2)
         m_shortcuts[(int)id].Alt = s.Alt;
+    mShortcutTableDirty = true;
+}
+
+static uint64_t ShortcutTableKey(int aKey, bool aCtrl, bool aAlt, bool aShift)
+{
+    return ((uint64_t)(uint32_t)aKey << 3) | ((uint64_t)aCtrl << 2) | ((uint64_t)aAlt << 1) | (uint64_t)aShift;
+}
+
+static void GetShortcutModifiers(bool& aCtrl, bool& aAlt, bool& aShift)
+{
+    ImGuiIO& io = ImGui::GetIO();
+#if IMGUICTE_USE_SDL2
+    aShift = io.KeyShift;
+    aCtrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
+    aAlt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
+#else
+    aCtrl = (io.KeyMods & ImGuiMod_Ctrl) != 0;
+    aAlt = (io.KeyMods & ImGuiMod_Alt) != 0;
+    aShift = (io.KeyMods & ImGuiMod_Shift) != 0;
+#endif
+}
+
+static bool IsShortcutKeyPressed(int aKey, bool aPrimary)
+{
+#if IMGUICTE_USE_SDL2
+    SDL_Scancode sc = SDL_GetScancodeFromKey(aKey);
+    return ImGui::IsKeyPressed(sc) || (aPrimary && sc == SDL_SCANCODE_RETURN && ImGui::IsKeyPressed(SDL_SCANCODE_KP_ENTER));
+#else
+    ImGuiKey key = (ImGuiKey)aKey;
+    return ImGui::IsKeyPressed(key) || (aPrimary && key == ImGuiKey_Enter && ImGui::IsKeyPressed(ImGuiKey_KeypadEnter));
+#endif
+}
+
+void TextEditor::BuildShortcutTable()
+{
+    mShortcutTable.clear();
+    mShortcutKeys.clear();
+    for (int i = 0; i < (int)m_shortcuts.size(); i++) {
+        auto& sct = m_shortcuts[i];
+        if (sct.Key1 == -1)
+            continue;
+
+        mShortcutTable[ShortcutTableKey(sct.Key1, sct.Ctrl, sct.Alt, sct.Shift)].push_back((ShortcutID)i);
+        if (std::find(mShortcutKeys.begin(), mShortcutKeys.end(), sct.Key1) == mShortcutKeys.end())
+            mShortcutKeys.push_back(sct.Key1);
+    }
+    mShortcutTableDirty = false;
+}
+
+std::vector<ShortcutID> TextEditor::GetPressedShortcuts()
+{
+    if (mShortcutTableDirty)
+        BuildShortcutTable();
+
+    bool ctrl, alt, shift;
+    GetShortcutModifiers(ctrl, alt, shift);
+
+    std::vector<ShortcutID> pressed;
+    for (int key : mShortcutKeys) {
+        if (!IsShortcutKeyPressed(key, true))
+            continue;
+
+        auto it = mShortcutTable.find(ShortcutTableKey(key, ctrl, alt, shift));
+        if (it == mShortcutTable.end())
+            continue;
+        for (ShortcutID id : it->second) {
+            int key2 = m_shortcuts[(int)id].Key2;
+            if (key2 == -1 || IsShortcutKeyPressed(key2, false))
+                pressed.push_back(id);
+        }
+    }
+    std::sort(pressed.begin(), pressed.end());
+    return pressed;
+}
+
+bool TextEditor::IsShortcutPressed(ShortcutID aID) const
+{
+    auto& sct = m_shortcuts[(int)aID];
+    if (sct.Key1 == -1 || !IsShortcutKeyPressed(sct.Key1, true))
+        return false;
+    if (sct.Key2 != -1 && !IsShortcutKeyPressed(sct.Key2, false))
+        return false;
+
+    bool ctrl, alt, shift;
+    GetShortcutModifiers(ctrl, alt, shift);
+    return sct.Ctrl == ctrl && sct.Alt == alt && sct.Shift == shift;
 }
 
 void TextEditor::Copy()
@@ -4857,6 +7250,10 @@ void TextEditor::Paste()
         return;
 
     auto clipText = ImGui::GetClipboardText();
+    if (mRecordingInput && !mInputRecording.empty() && clipText != nullptr) {
+        mInputRecording.back().mHasClipboard = true;
+        mInputRecording.back().mClipboard = clipText;
+    }
     if (clipText != nullptr && strlen(clipText) > 0)
     {
         UndoRecord u;
@@ -4873,7 +7270,7 @@ void TextEditor::Paste()
         u.mAdded = clipText;
         u.mAddedStart = GetActualCursorCoordinates();
 
-        InsertText(clipText, mAutoindentOnPaste);
+        InsertTextInternal(clipText, mAutoindentOnPaste);
 
         u.mAddedEnd = GetActualCursorCoordinates();
         u.mAfter = mState;
@@ -4903,17 +7300,43 @@ void TextEditor::Redo(int aSteps)
         mUndoBuffer[mUndoIndex++].Redo(this);
 }
 
+// languages whose lines GetRelevantExpressions() can split into C-like expressions
+static bool HasCStyleSyntax(const LanguageDefinition& aLanguage)
+{
+    for (auto& comment : aLanguage.single_line_comments)
+        if (comment == "//")
+            return true;
+    for (auto& comment : aLanguage.block_comments)
+        if (comment.first == "/*" && comment.second == "*/")
+            return true;
+    return false;
+}
+
 std::vector<std::string> TextEditor::GetRelevantExpressions(int line)
 {
     std::vector<std::string> ret;
     line--;
 
-    if (line < 0 || line >= mLines.size() || (mLanguageDefinition.mName != "HLSL" && mLanguageDefinition.mName != "GLSL"))
+    if (line < 0 || line >= mLines.size() || !HasCStyleSyntax(mLanguageDefinition))
         return ret;
 
-    std::string expr = "";
-    for (int i = 0; i < mLines[line].size(); i++)
-        expr += mLines[line][i].mChar;
+    // unchanged since the last call: neither the text nor the colors of the document changed
+    auto cached = mExpressionCache.find(line);
+    if (cached != mExpressionCache.end() && cached->second.mTextVersion == mTextVersion && cached->second.mColorVersion == mDocument->mColorVersion)
+        return cached->second.mExpressions;
+
+    // the comments found by the colorizer are blanked out, this text is also what the cache compares
+    const Line& glyphs = mLines[line];
+    std::string expr(glyphs.size(), ' ');
+    for (size_t i = 0; i < glyphs.size(); i++)
+        if (!glyphs[i].mComment && !glyphs[i].mMultiLineComment)
+            expr[i] = glyphs[i].mChar;
+
+    if (cached != mExpressionCache.end() && cached->second.mText == expr) {
+        cached->second.mTextVersion = mTextVersion;
+        cached->second.mColorVersion = mDocument->mColorVersion;
+        return cached->second.mExpressions;
+    }
 
     enum class TokenType {
         Identifier,
@@ -4928,48 +7351,46 @@ std::vector<std::string> TextEditor::GetRelevantExpressions(int line)
         std::string Content;
     };
 
-    char buffer[512] = { 0 };
-    int bufferLoc = 0;
+    size_t identifierStart = std::string::npos;
     std::vector<Token> tokens;
+    auto endIdentifier = [&](size_t aEnd) {
+        if (identifierStart != std::string::npos)
+            tokens.push_back({ TokenType::Identifier, expr.substr(identifierStart, aEnd - identifierStart) });
+        identifierStart = std::string::npos;
+    };
 
     // convert expression into list of tokens
-    const char* e = expr.c_str();
-    while (*e != 0) {
-        if (*e == '*' || *e == '/' || *e == '+' || *e == '-' || *e == '%' || *e == '&' || *e == '|' || *e == '=' || *e == '(' || *e == ')' || *e == ',' || *e == ';' || *e == '<' || *e == '>') {
-            if (bufferLoc != 0)
-                tokens.push_back({ TokenType::Identifier, std::string(buffer) });
-
-            memset(buffer, 0, 512);
-            bufferLoc = 0;
-
-            if (*e == '(' || *e == ')')
-                tokens.push_back({ TokenType::Parenthesis, std::string(e, 1) });
-            else if (*e == ',')
+    for (size_t i = 0; i < expr.size(); i++) {
+        char c = expr[i];
+        PaletteIndex color = glyphs[i].mColorIndex;
+        if (color == PaletteIndex::String || color == PaletteIndex::CharLiteral) {
+            // literals are taken whole from the colorizer's span, spaces and operators inside them don't split them
+            endIdentifier(i);
+            size_t end = i + 1;
+            while (end < expr.size() && glyphs[end].mColorIndex == color && !glyphs[end].mComment && !glyphs[end].mMultiLineComment)
+                end++;
+            tokens.push_back({ TokenType::Number, expr.substr(i, end - i) });
+            i = end - 1;
+        } else if (c == '*' || c == '/' || c == '+' || c == '-' || c == '%' || c == '&' || c == '|' || c == '=' || c == '(' || c == ')' || c == ',' || c == ';' || c == '<' || c == '>') {
+            endIdentifier(i);
+
+            if (c == '(' || c == ')')
+                tokens.push_back({ TokenType::Parenthesis, std::string(1, c) });
+            else if (c == ',')
                 tokens.push_back({ TokenType::Comma, "," });
-            else if (*e == ';')
+            else if (c == ';')
                 tokens.push_back({ TokenType::Semicolon, ";" });
             else
-                tokens.push_back({ TokenType::Operator, std::string(e, 1) });
-        } else if (*e == '{' || *e == '}')
+                tokens.push_back({ TokenType::Operator, std::string(1, c) });
+        } else if (c == '{' || c == '}') {
+            endIdentifier(i);
             break;
-        else if (*e == '\n' || *e == '\r' || *e == ' ' || *e == '\t') {
-            // empty the buffer if needed
-            if (bufferLoc != 0) {
-                tokens.push_back({ TokenType::Identifier, std::string(buffer) });
-
-                memset(buffer, 0, 512);
-                bufferLoc = 0;
-            }
-        } else {
-            buffer[bufferLoc] = *e;
-            bufferLoc++;
-        }
-        e++;
+        } else if (c == '\n' || c == '\r' || c == ' ' || c == '\t') {
+            endIdentifier(i);
+        } else if (identifierStart == std::string::npos)
+            identifierStart = i;
     }
-
-    // empty the buffer
-    if (bufferLoc != 0)
-        tokens.push_back({ TokenType::Identifier, std::string(buffer) });
+    endIdentifier(expr.size());
 
     // some "post processing"
     int multilineComment = 0;
@@ -5084,14 +7505,7 @@ std::vector<std::string> TextEditor::GetRelevantExpressions(int line)
                 exprBuffer.clear();
                 exprParenthesis = 0;
             } else {
-                bool isKeyword = false;
-                for (const auto& kwd : mLanguageDefinition.mKeywords) {
-                    if (kwd == tokens[i].Content) {
-                        isKeyword = true;
-                        break;
-                    }
-                }
-                if (!isKeyword)
+                if (mLanguageDefinition.mKeywords.count(tokens[i].Content) == 0)
                     exprBuffer += tokens[i].Content + " ";
             }
         }
@@ -5124,19 +7538,8 @@ std::vector<std::string> TextEditor::GetRelevantExpressions(int line)
             eraseR = true;
 
         // keyword
-        if (!eraseR) {
-            for (const auto& ident : mLanguageDefinition.mIdentifiers)
-                if (ident.first == r) {
-                    eraseR = true;
-                    break;
-                }
-
-            for (const auto& kwd : mLanguageDefinition.mKeywords)
-                if (kwd == r) {
-                    eraseR = true;
-                    break;
-                }
-        }
+        if (!eraseR)
+            eraseR = mLanguageDefinition.mIdentifiers.count(r) != 0 || mLanguageDefinition.mKeywords.count(r) != 0;
 
         // delete it from the array
         if (eraseR) {
@@ -5146,6 +7549,14 @@ std::vector<std::string> TextEditor::GetRelevantExpressions(int line)
         }
     }
 
+    // a debug session only steps through a few lines, keep the cache small
+    if (mExpressionCache.size() >= 256)
+        mExpressionCache.clear();
+    auto& entry = mExpressionCache[line];
+    entry.mTextVersion = mTextVersion;
+    entry.mColorVersion = mDocument->mColorVersion;
+    entry.mText = std::move(expr);
+    entry.mExpressions = ret;
     return ret;
 }
 
@@ -5271,6 +7682,129 @@ std::string TextEditor::GetText() const
     return GetText(Coordinates(), Coordinates((int)mLines.size(), 0));
 }
 
+bool TextEditor::ForEachChunk(const std::function<bool(const char*, size_t)>& aCallback) const
+{
+    return ForEachChunk(Coordinates(), Coordinates((int)mLines.size(), 0), aCallback);
+}
+
+bool TextEditor::ForEachChunk(const Coordinates& aStart, const Coordinates& aEnd, const std::function<bool(const char*, size_t)>& aCallback) const
+{
+    if (aStart.mLine >= (int)mLines.size() || aEnd < aStart)
+        return true;
+
+    auto lstart = aStart.mLine;
+    auto lend = aEnd.mLine;
+    auto istart = GetCharacterIndex(aStart);
+    auto iend = GetCharacterIndex(aEnd);
+
+    // an end past the last line is the end of the document
+    if (lend >= (int)mLines.size()) {
+        lend = (int)mLines.size() - 1;
+        iend = (int)mLines[lend].size();
+    }
+
+    // glyphs keep their flags next to the character, so the lines are gathered into a fixed buffer
+    std::unique_ptr<char[]> buffer(new char[TextChunkSize]);
+    size_t used = 0;
+    for (int ln = lstart; ln <= lend; ln++) {
+        auto& line = mLines[ln];
+        int from = ln == lstart ? istart : 0;
+        int to = ln == lend ? std::min<int>(iend, (int)line.size()) : (int)line.size();
+        for (int i = from; i < to; i++) {
+            if (used == TextChunkSize) {
+                if (!aCallback(buffer.get(), used))
+                    return false;
+                used = 0;
+            }
+            buffer[used++] = line[i].mChar;
+        }
+
+        if (ln < lend) {
+            if (used == TextChunkSize) {
+                if (!aCallback(buffer.get(), used))
+                    return false;
+                used = 0;
+            }
+            buffer[used++] = '\n';
+        }
+    }
+
+    return used == 0 || aCallback(buffer.get(), used);
+}
+
+bool TextEditor::WriteTo(std::ostream& aStream) const
+{
+    return ForEachChunk([&](const char* aData, size_t aSize) {
+        aStream.write(aData, (std::streamsize)aSize);
+        return aStream.good();
+    });
+}
+
+bool TextEditor::WriteTo(FILE* aFile) const
+{
+    return ForEachChunk([&](const char* aData, size_t aSize) {
+        return fwrite(aData, 1, aSize, aFile) == aSize;
+    });
+}
+
+std::shared_ptr<const TextEditor::DocumentSnapshot> TextEditor::Snapshot() const
+{
+    auto& document = *mDocument;
+    if (document.mSnapshot != nullptr && document.mSnapshot->mVersion == mTextVersion && !document.mSnapshotStale)
+        return document.mSnapshot;
+
+    // the edit paths and the colorizer reset the lines they change, only those are copied
+    auto& lines = document.mSnapshotLines;
+    lines.resize(mLines.size());
+    for (size_t i = 0; i < mLines.size(); i++) {
+        if (lines[i] == nullptr)
+            lines[i] = std::make_shared<const Line>(mLines[i]);
+    }
+
+    auto snapshot = std::make_shared<DocumentSnapshot>();
+    snapshot->mVersion = mTextVersion;
+    snapshot->mLines = lines;
+
+    document.mSnapshot = snapshot;
+    document.mSnapshotStale = false;
+    return snapshot;
+}
+
+void TextEditor::InvalidateSnapshotLines(int aFromLine, int aToLine)
+{
+    auto& lines = mDocument->mSnapshotLines;
+    aToLine = std::min<int>(aToLine, (int)lines.size());
+    for (int i = std::max<int>(0, aFromLine); i < aToLine; i++)
+        lines[i] = nullptr;
+    mDocument->mSnapshotStale = true;
+}
+
+std::string TextEditor::DocumentSnapshot::GetLineText(int aLine) const
+{
+    auto& line = *mLines[aLine];
+    std::string result(line.size(), '\0');
+    for (size_t i = 0; i < line.size(); i++)
+        result[i] = line[i].mChar;
+    return result;
+}
+
+std::string TextEditor::DocumentSnapshot::GetText() const
+{
+    size_t size = 0;
+    for (auto& line : mLines)
+        size += line->size() + 1;
+
+    std::string result;
+    result.reserve(size);
+    for (size_t i = 0; i < mLines.size(); i++) {
+        for (auto& glyph : *mLines[i])
+            result += glyph.mChar;
+        if (i + 1 < mLines.size())
+            result += '\n';
+    }
+    return result;
+}
+
 void TextEditor::GetTextLines(std::vector<std::string>& result) const
 {
     result.reserve(mLines.size());
@@ -5307,11 +7841,22 @@ void TextEditor::ProcessInputs()
 void TextEditor::Colorize(int aFromLine, int aLines)
 {
     int toLine = aLines == -1 ? (int)mLines.size() : std::min<int>((int)mLines.size(), aFromLine + aLines);
+    if (mEditDepth > 0) {
+        // colorized once by EndEdit()
+        mEditLineMin = std::min<int>(mEditLineMin, std::max<int>(0, aFromLine));
+        mEditLineMax = std::max<int>(mEditLineMax, toLine);
+        return;
+    }
+
+    // every edit recolors the lines it touched, so this is where their snapshot copies go stale
+    InvalidateSnapshotLines(aFromLine, toLine);
+
     mColorRangeMin = std::min<int>(mColorRangeMin, aFromLine);
     mColorRangeMax = std::max<int>(mColorRangeMax, toLine);
     mColorRangeMin = std::max<int>(0, mColorRangeMin);
     mColorRangeMax = std::max<int>(mColorRangeMin, mColorRangeMax);
     mCheckComments = true;
+    mCommentScanFrom = 0;
 }
 
 void TextEditor::ColorizeRange(int aFromLine, int aToLine)
@@ -5322,87 +7867,116 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
     std::string buffer;
     std::cmatch results;
     std::string id;
+    std::vector<std::string> words;
+    std::vector<PaletteIndex> colors;
+
+    // lines appended by AppendText() or LoadFileAsync() have no words yet
+    ResizeLineWords((int)mLines.size());
 
     int endLine = std::max(0, std::min((int)mLines.size(), aToLine));
-    for (int i = aFromLine; i < endLine; ++i)
-    {
+    for (int i = aFromLine; i < endLine; ++i) {
         auto& line = mLines[i];
+        colors.resize(line.size());
+        for (size_t j = 0; j < line.size(); j++)
+            colors[j] = line[j].mColorIndex;
 
-        if (line.empty())
-            continue;
+        words.clear();
+        ColorizeLine(line, i, buffer, results, id, &words);
+        SetLineWords(i, words);
 
-        buffer.resize(line.size());
-        for (size_t j = 0; j < line.size(); ++j)
-        {
-            auto& col = line[j];
-            buffer[j] = col.mChar;
-            col.mColorIndex = PaletteIndex::Default;
+        for (size_t j = 0; j < line.size(); j++) {
+            if (colors[j] != line[j].mColorIndex) {
+                InvalidateSnapshotLines(i, i + 1);
+                break;
+            }
         }
+    }
+
+    if (aFromLine < endLine)
+        mDocument->mColorVersion++;
+}
 
-        const char* bufferBegin = &buffer.front();
-        const char* bufferEnd = bufferBegin + buffer.size();
+void TextEditor::ColorizeLine(Line& line, int i, std::string& buffer, std::cmatch& results, std::string& id, std::vector<std::string>* aWords)
+{
+#if !IMGUICTE_ENABLE_SPIRV
+    (void)i; // the line number only scopes function arguments and locals
+#endif
 
-        auto last = bufferEnd;
+    if (line.empty())
+        return;
 
-        for (auto first = bufferBegin; first != last; )
-        {
-            const char* token_begin = nullptr;
-            const char* token_end = nullptr;
-            PaletteIndex token_color = PaletteIndex::Default;
+    buffer.resize(line.size());
+    for (size_t j = 0; j < line.size(); ++j)
+    {
+        auto& col = line[j];
+        buffer[j] = col.mChar;
+        col.mColorIndex = PaletteIndex::Default;
+    }
 
-            bool hasTokenizeResult = false;
+    const char* bufferBegin = &buffer.front();
+    const char* bufferEnd = bufferBegin + buffer.size();
 
-            if (mLanguageDefinition.mTokenize != nullptr)
-            {
-                if (mLanguageDefinition.mTokenize(first, last, token_begin, token_end, token_color))
-                    hasTokenizeResult = true;
-            }
+    auto last = bufferEnd;
 
-            if (hasTokenizeResult == false)
-            {
-                // todo : remove
-                    //printf("using regex for %.*s\n", first + 10 < last ? 10 : int(last - first), first);
+    for (auto first = bufferBegin; first != last; )
+    {
+        const char* token_begin = nullptr;
+        const char* token_end = nullptr;
+        PaletteIndex token_color = PaletteIndex::Default;
+
+        bool hasTokenizeResult = false;
+
+        if (mLanguageDefinition.mTokenize != nullptr)
+        {
+            if (mLanguageDefinition.mTokenize(first, last, token_begin, token_end, token_color))
+                hasTokenizeResult = true;
+        }
+
+        if (hasTokenizeResult == false)
+        {
+            // todo : remove
+                //printf("using regex for %.*s\n", first + 10 < last ? 10 : int(last - first), first);
 
-                for (auto& p : mRegexList)
+            for (auto& p : mRegexList)
+            {
+                if (std::regex_search(first, last, results, p.first, std::regex_constants::match_continuous))
                 {
-                    if (std::regex_search(first, last, results, p.first, std::regex_constants::match_continuous))
-                    {
-                        hasTokenizeResult = true;
+                    hasTokenizeResult = true;
 
-                        auto& v = *results.begin();
-                        token_begin = v.first;
-                        token_end = v.second;
-                        token_color = p.second;
-                        break;
-                    }
+                    auto& v = *results.begin();
+                    token_begin = v.first;
+                    token_end = v.second;
+                    token_color = p.second;
+                    break;
                 }
             }
+        }
 
-            if (hasTokenizeResult == false)
-            {
-                first++;
-            }
-            else
-            {
-                const size_t token_length = token_end - token_begin;
+        if (hasTokenizeResult == false)
+        {
+            first++;
+        }
+        else
+        {
+            const size_t token_length = token_end - token_begin;
 
-                if (token_color == PaletteIndex::Identifier)
-                {
-                    id.assign(token_begin, token_end);
+            if (token_color == PaletteIndex::Identifier)
+            {
+                id.assign(token_begin, token_end);
 
-                    // todo : allmost all language definitions use lower case to specify keywords, so shouldn't this use ::tolower ?
-                    if (!mLanguageDefinition.mCaseSensitive)
-                        std::transform(id.begin(), id.end(), id.begin(), ::toupper);
+                // todo : allmost all language definitions use lower case to specify keywords, so shouldn't this use ::tolower ?
+                if (!mLanguageDefinition.mCaseSensitive)
+                    std::transform(id.begin(), id.end(), id.begin(), ::toupper);
 
-                    if (!line[first - bufferBegin].mPreprocessor)
-                    {
-                        if (mLanguageDefinition.mKeywords.count(id) != 0)
-                            token_color = PaletteIndex::Keyword;
-                        else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
-                            token_color = PaletteIndex::KnownIdentifier;
-                        else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-                            token_color = PaletteIndex::PreprocIdentifier;
-                                                else {
+                if (!line[first - bufferBegin].mPreprocessor)
+                {
+                    if (mLanguageDefinition.mKeywords.count(id) != 0)
+                        token_color = PaletteIndex::Keyword;
+                    else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
+                        token_color = PaletteIndex::KnownIdentifier;
+                    else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
+                        token_color = PaletteIndex::PreprocIdentifier;
+                                            else {
 #if IMGUICTE_ENABLE_SPIRV
                                                         bool found = false;
 
@@ -5471,22 +8045,84 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 #endif
                                                 }
                     }
-                    else
-                    {
-                        if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-                            token_color = PaletteIndex::PreprocIdentifier;
-                    }
+                else
+                {
+                    if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
+                        token_color = PaletteIndex::PreprocIdentifier;
                 }
+            }
+
+            if (aWords != nullptr && token_color == PaletteIndex::Identifier && token_length > 1)
+                aWords->emplace_back(token_begin, token_end);
+
+            for (size_t j = 0; j < token_length; ++j)
+                line[(token_begin - bufferBegin) + j].mColorIndex = token_color;
+
+            first = token_end;
+        }
+    }
+}
+
+void TextEditor::SetLineWords(int aLine, const std::vector<std::string>& aWords)
+{
+    auto& document = *mDocument;
+
+    std::vector<int> ids;
+    ids.reserve(aWords.size());
+    for (auto& word : aWords) {
+        auto it = document.mWordIds.find(word);
+        if (it != document.mWordIds.end()) {
+            ids.push_back(it->second);
+            continue;
+        }
 
-                for (size_t j = 0; j < token_length; ++j)
-                    line[(token_begin - bufferBegin) + j].mColorIndex = token_color;
+        int index;
+        if (!document.mFreeWords.empty()) {
+            index = document.mFreeWords.back();
+            document.mFreeWords.pop_back();
+        } else {
+            index = (int)document.mWords.size();
+            document.mWords.emplace_back();
+        }
+        document.mWords[index].mCandidate = mMakeACCandidate(word, word, word, false, false);
+        document.mWords[index].mRefs = 0;
+        document.mWordIds[word] = index;
+        ids.push_back(index);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    // reference the new words before the old ones are released so that shared ids stay valid
+    for (int index : ids)
+        document.mWords[index].mRefs++;
+    ReleaseLineWords(aLine, aLine + 1);
+    document.mLineWords[aLine] = std::move(ids);
+}
 
-                first = token_end;
+void TextEditor::ReleaseLineWords(int aFrom, int aTo)
+{
+    auto& document = *mDocument;
+    for (int i = aFrom; i < aTo; i++) {
+        for (int index : document.mLineWords[i]) {
+            auto& word = document.mWords[index];
+            if (--word.mRefs == 0) {
+                document.mWordIds.erase(word.mCandidate.mDisplay);
+                word.mCandidate = ACCandidate();
+                document.mFreeWords.push_back(index);
             }
         }
+        document.mLineWords[i].clear();
     }
 }
 
+void TextEditor::ResizeLineWords(int aCount)
+{
+    auto& lineWords = mDocument->mLineWords;
+    if (aCount < (int)lineWords.size())
+        ReleaseLineWords(aCount, (int)lineWords.size());
+    lineWords.resize(aCount);
+}
+
 void TextEditor::ColorizeInternal()
 {
     if (mLines.empty() || !mColorizerEnabled)
@@ -5496,19 +8132,56 @@ void TextEditor::ColorizeInternal()
     {
         auto endLine = mLines.size();
         auto endIndex = 0;
-        auto commentStartLine = endLine;
+
+        // AppendText() resumes from the state saved at the start of the last line
+        CommentScanState state;
+        if (mCommentScanFrom > 0 && mCommentScanFrom == mTailCommentLine && mTailCommentLine < (int)endLine)
+            state = mTailCommentState;
+        else
+            mCommentScanFrom = 0;
+
+        auto commentStartLine = state.mInBlockComment ? (size_t)mCommentScanFrom : endLine;
         auto commentStartIndex = endIndex;
-        auto withinString = false;
-        auto withinSingleLineComment = false;
-        auto withinPreproc = false;
-        auto firstChar = true;          // there is no other non-whitespace characters in the line before
-        auto concatenate = false;       // '\' on the very end of the line
-        auto currentLine = 0;
+        auto withinString = state.mInString;
+        auto withinSingleLineComment = state.mInLineComment;
+        auto withinPreproc = state.mInPreproc;
+        auto firstChar = state.mFirstChar;      // there is no other non-whitespace characters in the line before
+        auto concatenate = state.mConcatenate;  // '\' on the very end of the line
+        auto currentLine = mCommentScanFrom;
         auto currentIndex = 0;
+
+        // only the lines whose comment flags change lose their snapshot copy
+        std::vector<uint8_t> flags;
+        auto glyphFlags = [](const Glyph& aGlyph) { return (uint8_t)(aGlyph.mComment | aGlyph.mMultiLineComment << 1 | aGlyph.mPreprocessor << 2); };
+        auto lineScanned = [&](const Line& aLine, int aIndex) {
+            for (size_t i = 0; i < aLine.size(); i++) {
+                if (flags[i] != glyphFlags(aLine[i])) {
+                    InvalidateSnapshotLines(aIndex, aIndex + 1);
+                    break;
+                }
+            }
+        };
+
         while (currentLine < endLine || currentIndex < endIndex)
         {
             auto& line = mLines[currentLine];
 
+            if (currentIndex == 0) {
+                flags.resize(line.size());
+                for (size_t i = 0; i < line.size(); i++)
+                    flags[i] = glyphFlags(line[i]);
+            }
+
+            if (currentIndex == 0 && currentLine == (int)endLine - 1) {
+                mTailCommentLine = currentLine;
+                mTailCommentState.mInBlockComment = commentStartLine <= (size_t)currentLine;
+                mTailCommentState.mInString = withinString;
+                mTailCommentState.mInLineComment = withinSingleLineComment;
+                mTailCommentState.mInPreproc = withinPreproc;
+                mTailCommentState.mFirstChar = firstChar;
+                mTailCommentState.mConcatenate = concatenate;
+            }
+
             if (currentIndex == 0 && !concatenate)
             {
                 withinSingleLineComment = false;
@@ -5606,6 +8279,7 @@ void TextEditor::ColorizeInternal()
                 currentIndex += UTF8CharLength(c);
                 if (currentIndex >= (int)line.size())
                 {
+                    lineScanned(line, currentLine);
                     currentIndex = 0;
                     ++currentLine;
                 }
@@ -5617,6 +8291,7 @@ void TextEditor::ColorizeInternal()
             }
         }
         mCheckComments = false;
+        mDocument->mColorVersion++;
     }
 
     if (mColorRangeMin < mColorRangeMax)
@@ -5733,6 +8408,18 @@ TextEditor::UndoRecord::UndoRecord(
 
 void TextEditor::UndoRecord::Undo(TextEditor * aEditor)
 {
+    if (!mOperations.empty())
+    {
+        aEditor->BeginEdit();
+        for (auto it = mOperations.rbegin(); it != mOperations.rend(); ++it)
+            it->Undo(aEditor);
+        aEditor->EndEdit();
+
+        aEditor->mState = mBefore;
+        aEditor->EnsureCursorVisible();
+        return;
+    }
+
     if (!mAdded.empty())
     {
         aEditor->DeleteRange(mAddedStart, mAddedEnd);
@@ -5753,17 +8440,29 @@ void TextEditor::UndoRecord::Undo(TextEditor * aEditor)
 
 void TextEditor::UndoRecord::Redo(TextEditor * aEditor)
 {
+    if (!mOperations.empty())
+    {
+        aEditor->BeginEdit();
+        for (auto& operation : mOperations)
+            operation.Redo(aEditor);
+        aEditor->EndEdit();
+
+        aEditor->mState = mAfter;
+        aEditor->EnsureCursorVisible();
+        return;
+    }
+
     if (!mRemoved.empty())
     {
         aEditor->DeleteRange(mRemovedStart, mRemovedEnd);
-        aEditor->Colorize(mRemovedStart.mLine - 1, mRemovedEnd.mLine - mRemovedStart.mLine + 1);
+        aEditor->Colorize(mRemovedStart.mLine - 1, mRemovedEnd.mLine - mRemovedStart.mLine + 2);
     }
 
     if (!mAdded.empty())
     {
         auto start = mAddedStart;
         aEditor->InsertTextAt(start, mAdded.c_str());
-        aEditor->Colorize(mAddedStart.mLine - 1, mAddedEnd.mLine - mAddedStart.mLine + 1);
+        aEditor->Colorize(mAddedStart.mLine - 1, mAddedEnd.mLine - mAddedStart.mLine + 2);
     }
 
     aEditor->mState = mAfter;
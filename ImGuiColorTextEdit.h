@@ -12,7 +12,13 @@
 #include <unordered_map>
 #include <functional>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iosfwd>
 #include <map>
+#include <list>
 #include <regex>
 #include <imgui.h>
 
@@ -338,6 +344,46 @@ namespace ImTextEdit {
             }
         };
 
+        /// \brief Replacement of a range with new text, applied by ApplyEdits().
+        struct TextEdit {
+            Coordinates mStart;     ///< Start of the range to replace.
+            Coordinates mEnd;       ///< End of the range to replace, equal to mStart for insertions.
+            std::string mText;      ///< Replacement text.
+        };
+
+        /// \brief Single change of the document, as reported by OnTextChanges.
+        /// \note Unlike the editor coordinates, mColumn holds the glyph (byte) index into the line, tabs count as one.
+        struct TextChange {
+            Coordinates mStart;     ///< Start of the replaced range, in the text before the change.
+            Coordinates mEnd;       ///< End of the replaced range, in the text before the change.
+            std::string mText;      ///< Text that replaced the range, empty for deletions.
+            uint64_t mVersion;      ///< Document version after the change.
+        };
+
+        /// \brief ImGui input event recorded by StartInputRecording().
+        struct InputEvent {
+            enum class Type { Key, Char, MousePos, MouseButton, MouseWheel, Focus };
+            Type mType;
+            int mCode;      ///< ImGuiKey, character or mouse button.
+            bool mDown;     ///< Key or button state, window focus for Type::Focus.
+            ImVec2 mValue;  ///< Mouse position relative to the editor or wheel delta.
+        };
+
+        /// \brief Input of one editor frame.
+        struct InputFrame {
+            float mDeltaTime = 0.0f;
+            std::vector<InputEvent> mEvents;
+            bool mHasClipboard = false;     ///< Paste() read mClipboard during the frame.
+            std::string mClipboard;
+        };
+        typedef std::vector<InputFrame> InputRecording;
+
+        /// \brief Timings measured by ReplayInput().
+        struct ReplayStats {
+            std::vector<double> mFrameTimes;        ///< Milliseconds spent in each replayed frame.
+            std::vector<double> mKeystrokeTimes;    ///< Milliseconds of the frames with key or character input.
+        };
+
         typedef std::string String;
         typedef std::map<int, std::string> ErrorMarkers;
         typedef std::array<ImU32, (unsigned)PaletteIndex::Max> Palette;
@@ -363,11 +409,59 @@ namespace ImTextEdit {
         typedef std::vector<Glyph> Line;
         typedef std::vector<Line> Lines;
 
+        class Document;
+
+        /// \brief Immutable copy of the text and colors at a version, safe to read from any thread.
+        /// \note Lines that did not change between two snapshots are shared by them.
+        class DocumentSnapshot
+        {
+        public:
+            /// \brief Get the document version the snapshot was taken at.
+            /// \return Value of GetTextVersion() at the time of the snapshot.
+            uint64_t GetVersion() const { return mVersion; }
+
+            /// \brief Get the number of lines.
+            /// \return Line count.
+            int GetLineCount() const { return (int)mLines.size(); }
+
+            /// \brief Get the glyphs of a line.
+            /// \param aLine Zero-based line index.
+            /// \return Characters of the line with their colors.
+            const Line& GetLine(int aLine) const { return *mLines[aLine]; }
+
+            /// \brief Get the text of a line.
+            /// \param aLine Zero-based line index.
+            /// \return Line text without the line break.
+            std::string GetLineText(int aLine) const;
+
+            /// \brief Get the whole text.
+            /// \return Lines joined with '\n'.
+            std::string GetText() const;
+
+        private:
+            friend class TextEditor;
+
+            uint64_t mVersion = 0;
+            std::vector<std::shared_ptr<const Line>> mLines;
+        };
+
         /// \brief Create a text editor instance.
         TextEditor();
+        /// \brief Create a view of a document shared with other editors.
+        /// \param aDocument Document holding the text, colors, folds, markers and undo history.
+        /// \note Edits from any view update all of them. The document is colorized with the language
+        ///       definition of the view that renders first, so all views should use the same one.
+        explicit TextEditor(std::shared_ptr<Document> aDocument);
         /// \brief Destroy the editor instance.
         ~TextEditor();
 
+        TextEditor(const TextEditor&) = delete;
+        TextEditor& operator=(const TextEditor&) = delete;
+
+        /// \brief Get the document shown by this editor.
+        /// \return Document that can be passed to other editors to show the same text.
+        inline std::shared_ptr<Document> GetDocument() const { return mDocument; }
+
         /// \brief Set the language definition used for syntax highlighting.
         /// \param aLanguageDef Language definition to apply.
         void SetLanguageDefinition(const LanguageDefinition& aLanguageDef);
@@ -389,6 +483,7 @@ namespace ImTextEdit {
         void RemoveBreakpoint(int line);
         void SetBreakpointEnabled(int line, bool enable);
         Breakpoint& GetBreakpoint(int line);
+        /// \brief Get all breakpoints, sorted by line.
         inline const std::vector<Breakpoint>& GetBreakpoints() { return mBreakpoints; }
         void SetCurrentLineIndicator(int line, bool displayBar = true);
         inline int GetCurrentLineIndicator() { return mDebugCurrentLine; }
@@ -406,10 +501,40 @@ namespace ImTextEdit {
         /// \endcode
         void Render(const char* aTitle, const ImVec2& aSize = ImVec2(), bool aBorder = false);
 
+        /// \brief Record the ImGui input of each Render() call, e.g. to replay an editing session.
+        inline void StartInputRecording() { mInputRecording.clear(); mRecordingInput = true; }
+        /// \brief Stop recording input.
+        /// \return Frames recorded since StartInputRecording().
+        InputRecording StopInputRecording();
+        /// \brief Determine if input is being recorded.
+        /// \return True between StartInputRecording() and StopInputRecording().
+        inline bool IsRecordingInput() const { return mRecordingInput; }
+
+        /// \brief Write a recording as text.
+        /// \return False if the stream failed.
+        static bool SaveInputRecording(const InputRecording& aRecording, std::ostream& aStream);
+        /// \brief Read a recording written by SaveInputRecording().
+        /// \return False if the stream is not a valid recording.
+        static bool LoadInputRecording(InputRecording& aRecording, std::istream& aStream);
+
+        /// \brief Drive the editor through a recording in a headless ImGui context and time each frame.
+        /// \param aRecording Frames to replay.
+        /// \param aSize Size of the window that hosts the editor, should match the recorded session.
+        /// \return Per-frame and per-keystroke timings in milliseconds.
+        /// \note Creates its own ImGui context and restores the current one afterwards, the editor must not
+        ///       be rendered in between.
+        ReplayStats ReplayInput(const InputRecording& aRecording, const ImVec2& aSize = ImVec2(1280, 720));
+
         /// \brief Replace the entire editor contents.
         /// \param aText New text to display.
         void SetText(const std::string& aText);
 
+        /// \brief Replace the text with a new version of it, e.g. after the file changed on disk.
+        /// \param aText New text.
+        /// \note Only the lines that differ are replaced, as a single undo step. Unchanged lines keep
+        ///       their colors, folds and markers, and the cursor stays on the same text.
+        void ReloadText(const std::string& aText);
+
         /// \brief Retrieve all text from the editor.
         /// \return Complete text buffer.
         std::string GetText() const;
@@ -422,6 +547,79 @@ namespace ImTextEdit {
         /// \param out Destination vector receiving one string per line.
         void GetTextLines(std::vector<std::string>& out) const;
 
+        /// \brief Take an immutable snapshot of the text and colors for background threads.
+        /// \return Snapshot that stays valid and unchanged while the document is edited.
+        /// \note Only the lines edited or recolored since the previous snapshot are copied, the others
+        ///       are shared with it. The snapshot is reused until the text or colors change.
+        std::shared_ptr<const DocumentSnapshot> Snapshot() const;
+
+        /// \brief Stream the text in chunks without building a copy of the whole document.
+        /// \param aCallback Receives each chunk, returns false to stop.
+        /// \return False if the callback stopped the iteration.
+        bool ForEachChunk(const std::function<bool(const char*, size_t)>& aCallback) const;
+
+        /// \brief Stream the text between two positions in chunks.
+        /// \param aStart Start of the range.
+        /// \param aEnd End of the range, a line past the last one means the end of the document.
+        /// \param aCallback Receives each chunk, returns false to stop.
+        /// \return False if the callback stopped the iteration.
+        bool ForEachChunk(const Coordinates& aStart, const Coordinates& aEnd, const std::function<bool(const char*, size_t)>& aCallback) const;
+
+        /// \brief Write the text to a stream without building a copy of the whole document.
+        /// \param aStream Destination stream.
+        /// \return True if every chunk was written.
+        bool WriteTo(std::ostream& aStream) const;
+
+        /// \brief Write the text to a file without building a copy of the whole document.
+        /// \param aFile Destination file opened for writing.
+        /// \return True if every chunk was written.
+        bool WriteTo(FILE* aFile) const;
+
+        /// \brief Load a file on a background thread, its lines appear in the editor as they are read.
+        /// \param aPath Path of the file to load.
+        /// \return False if the file could not be opened.
+        /// \note Replaces the text and clears the undo history like SetText(). Lines are added from Render().
+        bool LoadFileAsync(const std::string& aPath);
+
+        /// \brief Stop a load started with LoadFileAsync(), keeping the lines read so far.
+        void CancelLoad();
+
+        /// \brief Check whether LoadFileAsync() is still running.
+        /// \return True until the whole file has been added to the editor.
+        bool IsLoading() const { return mLoadJob != nullptr; }
+
+        /// \brief Show a file read-only through a memory mapping, decoding only the visible lines.
+        /// \param aPath Path of the file to map.
+        /// \return False if the file could not be mapped.
+        /// \note Meant for files too large to load. The line index is built in the background and
+        ///       the view is left by CloseFileView(), SetText() or LoadFileAsync().
+        bool OpenFileView(const std::string& aPath);
+
+        /// \brief Leave the file view and unmap the file.
+        void CloseFileView();
+
+        /// \brief Check whether a file opened with OpenFileView() is shown.
+        /// \return True while in the file view.
+        bool IsFileView() const { return mFileView != nullptr; }
+
+        /// \brief Get the number of lines indexed so far in the file view.
+        /// \return Line count, 0 when no file view is open.
+        int64_t GetFileViewLineCount() const;
+
+        /// \brief Look for text in the file view on a worker thread and scroll to it once found.
+        /// \param aText Text to look for, matched case sensitively.
+        /// \param aFromLine Line at which the search starts.
+        /// \return False if there is no file view, the text is empty or the line is not indexed yet.
+        /// \note The result is passed to OnFileViewFind. A new search or CloseFileView() cancels the running one.
+        bool FindInFileView(const std::string& aText, int64_t aFromLine = 0);
+
+        /// \brief Check whether FindInFileView() is still searching.
+        /// \return True until the result has been reported.
+        bool IsSearchingFileView() const { return mFileViewSearch != nullptr; }
+
+        /// \brief Stop a running FindInFileView() search, OnFileViewFind is not called for it.
+        void CancelFileViewSearch();
+
         /// \brief Get currently selected text.
         /// \return Selected substring or empty string if nothing is selected.
         std::string GetSelectedText() const;
@@ -434,6 +632,20 @@ namespace ImTextEdit {
         /// \return Line count.
         int GetTotalLines() const { return (int)mLines.size(); }
 
+        /// \brief Get the size of the text returned by GetText().
+        /// \return Byte count, line breaks included.
+        uint64_t GetTextSize() const;
+
+        /// \brief Convert a position to a byte offset into the text returned by GetText().
+        /// \param aPosition Position to convert.
+        /// \return 64-bit byte offset.
+        uint64_t GetOffset(const Coordinates& aPosition) const;
+
+        /// \brief Convert a byte offset into the text returned by GetText() to a position.
+        /// \param aOffset 64-bit byte offset, clamped to the line it falls in.
+        /// \return Position in line and visual column.
+        Coordinates GetCoordinates(uint64_t aOffset) const;
+
         /// \brief Determine if overwrite mode is active.
         /// \return True when characters replace existing ones.
         bool IsOverwrite() const { return mOverwrite; }
@@ -454,6 +666,13 @@ namespace ImTextEdit {
         /// \return True if content was modified.
         bool IsTextChanged() const { return mTextChanged; }
 
+        /// \brief Get the document version, incremented on every change of the text.
+        /// \return Current version.
+        uint64_t GetTextVersion() const { return mTextVersion; }
+
+        /// \brief Deliver pending changes to OnTextChanges of every view of the document without waiting for the end of the frame.
+        void FlushTextChanges();
+
         /// \brief Check whether the cursor position has changed.
         /// \return True if the cursor moved.
         bool IsCursorPositionChanged() const { return mCursorPositionChanged; }
@@ -523,6 +742,41 @@ namespace ImTextEdit {
         /// \param indent True to auto-indent inserted text.
         void InsertText(const char* aValue, bool indent = false);
 
+        /// \brief Apply a set of non-overlapping edits in a single pass over the document.
+        /// \param aEdits Edits in coordinates of the current document, in any order.
+        /// \return False if an edit ends before it starts or overlaps another one, the document is left unchanged then.
+        /// \note Edits at the same position are inserted in the order given. Cursor, selection, folds
+        ///       and markers are remapped once and the whole set is recorded as a single undo step.
+        bool ApplyEdits(std::vector<TextEdit> aEdits);
+
+        /// \brief Append text to the end of the document, for log views.
+        /// \param aText Text to append, may span several lines.
+        /// \note No undo is recorded and only the appended lines are colorized. Lines over the limit set
+        ///       with SetMaxLineCount() are dropped from the front, which also clears the undo history.
+        void AppendText(const std::string& aText);
+
+        /// \brief Append text to the end of the document, for log views.
+        /// \param aText Text to append, does not need to be null-terminated.
+        /// \param aSize Size of the text in bytes.
+        void AppendText(const char* aText, size_t aSize);
+
+        /// \brief Limit the number of lines kept by AppendText().
+        /// \param aCount Maximum number of lines, 0 to keep every line.
+        /// \note Once exceeded, a quarter of the limit is dropped from the front at once.
+        inline void SetMaxLineCount(int aCount) { mMaxLineCount = aCount; }
+
+        /// \brief Get the number of lines kept by AppendText().
+        /// \return Maximum number of lines, 0 when unlimited.
+        inline int GetMaxLineCount() const { return mMaxLineCount; }
+
+        /// \brief Follow the text added by AppendText() while the view is scrolled to the bottom.
+        /// \param aValue True to keep the last line in view.
+        inline void SetAutoScroll(bool aValue) { mAutoScroll = aValue; }
+
+        /// \brief Determine if the view follows the text added by AppendText().
+        /// \return True when auto-scrolling is enabled.
+        inline bool IsAutoScroll() const { return mAutoScroll; }
+
         /// \brief Move the cursor up by a number of lines.
         /// \param aAmount Number of lines to move.
         /// \param aSelect True to extend the selection.
@@ -613,9 +867,25 @@ namespace ImTextEdit {
         /// \param aSteps Number of steps to redo.
         void Redo(int aSteps = 1);
 
+        /// \brief Start a batch of edits.
+        /// \note Calls can be nested; only the outermost BeginEdit()/EndEdit() pair applies the batch.
+        /// \note Error markers and breakpoints set during a batch use the line numbers after the batch;
+        ///       GetBreakpoints() only lists the ones set during the batch until EndEdit().
+        void BeginEdit();
+
+        /// \brief Finish a batch of edits started with BeginEdit().
+        /// \note Folds, markers and colorization are updated once, OnContentUpdate fires once and
+        ///       the whole batch is recorded as a single undo step.
+        void EndEdit();
+
+        /// \brief Check whether a batch of edits is in progress.
+        /// \return True between BeginEdit() and the matching EndEdit().
+        bool IsInEdit() const { return mEditDepth > 0; }
+
         /// \brief Get expressions relevant for debugging on a given line.
         /// \param line Line index to inspect.
         /// \return List of expressions.
+        /// \note Works for languages with C-style comments; results are cached until the line changes.
         std::vector<std::string> GetRelevantExpressions(int line);
 
         /// \brief Highlight specific lines.
@@ -736,6 +1006,7 @@ namespace ImTextEdit {
         /// \param aFromLine First line index.
         /// \param aToLine Last line index.
         void ColorizeRange(int aFromLine = 0, int aToLine = 0);
+        void ColorizeLine(Line& line, int i, std::string& buffer, std::cmatch& results, std::string& id, std::vector<std::string>* aWords = nullptr);
 
         /// \brief Recompute syntax highlighting for the entire document.
         void ColorizeInternal();
@@ -747,15 +1018,13 @@ namespace ImTextEdit {
                 mACUserTypes.clear();
                 mACUniforms.clear();
                 mACGlobals.clear();
+                mACCandidatesDirty = true;
         }
 #       else
         inline void ClearAutocompleteData() {}
 #       endif
-        inline void ClearAutocompleteEntries()
-        {
-                mACEntries.clear();
-                mACEntrySearch.clear();
-        }
+        /// \brief Remove the entries added with AddAutocompleteEntry().
+        void ClearAutocompleteEntries();
 #       if IMGUICTE_ENABLE_SPIRV
         inline const std::unordered_map<std::string, ed::SPIRVParser::Function>& GetAutocompleteFunctions() { return mACFunctions; }
         inline const std::unordered_map<std::string, std::vector<ed::SPIRVParser::Variable>>& GetAutocompleteUserTypes() { return mACUserTypes; }
@@ -764,31 +1033,60 @@ namespace ImTextEdit {
         inline void SetAutocompleteFunctions(const std::unordered_map<std::string, ed::SPIRVParser::Function>& funcs)
         {
                 mACFunctions = funcs;
+                mACCandidatesDirty = true;
         }
         inline void SetAutocompleteUserTypes(const std::unordered_map<std::string, std::vector<ed::SPIRVParser::Variable>>& utypes)
         {
                 mACUserTypes = utypes;
+                mACCandidatesDirty = true;
         }
         inline void SetAutocompleteUniforms(const std::vector<ed::SPIRVParser::Variable>& unis)
         {
                 mACUniforms = unis;
+                mACCandidatesDirty = true;
         }
         inline void SetAutocompleteGlobals(const std::vector<ed::SPIRVParser::Variable>& globs)
         {
                 mACGlobals = globs;
+                mACCandidatesDirty = true;
         }
 #       endif
         /// \brief Add a custom autocomplete entry.
         /// \param search Lookup string used for filtering suggestions.
         /// \param display Text displayed in the suggestion list.
         /// \param value  Text inserted when the suggestion is accepted.
-        inline void AddAutocompleteEntry(const std::string& search, const std::string& display, const std::string& value)
+        /// \note Entries are indexed as they are added, lookups do not rescan them.
+        void AddAutocompleteEntry(const std::string& search, const std::string& display, const std::string& value);
+
+        /// \brief Request passed to an autocomplete provider.
+        struct AutocompleteRequest
         {
-            mACEntrySearch.push_back(search);
-            mACEntries.push_back(std::make_pair(display, value));
-        }
+            uint64_t mVersion = 0;                                  ///< Document version of the request.
+            Coordinates mCursor;                                    ///< Cursor position of the request.
+            std::string mPrefix;                                    ///< Word being completed.
+            std::shared_ptr<const DocumentSnapshot> mSnapshot;      ///< Text at mVersion, safe to read from any thread.
+            std::shared_ptr<const std::atomic<bool>> mCancelled;    ///< Set once the user typed further.
+
+            /// \brief Determine if the result is no longer needed.
+            /// \return True when the provider can stop early.
+            bool IsCancelled() const { return mCancelled != nullptr && *mCancelled; }
+        };
+        /// \brief Returns (display, value) suggestions, called off the UI thread.
+        typedef std::function<std::vector<std::pair<std::string, std::string>>(const AutocompleteRequest&)> AutocompleteProvider;
+
+        /// \brief Set a completer that runs off the UI thread, e.g. a semantic one.
+        /// \param aProvider Provider called for each autocomplete request, nullptr to remove it.
+        /// \param aDelay Milliseconds without typing before the provider is called.
+        /// \note Results that arrive for the current version and cursor are added to the popup.
+        void SetAutocompleteProvider(AutocompleteProvider aProvider, int aDelay = 150);
+
+        /// \brief Run autocomplete providers on a host executor instead of a detached thread.
+        /// \param aExecutor Receives the work to run, nullptr for a detached thread per request.
+        inline void SetAutocompleteExecutor(const std::function<void(std::function<void()>)>& aExecutor) { mACExecutor = aExecutor; }
         std::function<void(TextEditor*, int)> OnDebuggerJump;
         std::function<void(TextEditor*, DebugAction)> OnDebuggerAction;
+        /// \brief Has*Hover is asked once per hovered word or expression (and again after an edit or debugger step),
+        /// On*Hover draws the tooltip contents every frame while it is shown.
         std::function<void(TextEditor*, const std::string&)> OnIdentifierHover;
         std::function<bool(TextEditor*, const std::string&)> HasIdentifierHover;
         std::function<void(TextEditor*, const std::string&)> OnExpressionHover;
@@ -798,12 +1096,51 @@ namespace ImTextEdit {
 
         std::function<void(TextEditor*, const std::string&, Coordinates coords)> OnCtrlAltClick;
         std::function<void(TextEditor*, const std::string&, const std::string&)> RequestOpen;
+        /// \brief Called after the text changed, by edits made through any view of the document.
         std::function<void(TextEditor*)> OnContentUpdate;
-
-        inline void SetPath(const std::string& path) { mPath = path; }
+        /// \brief Receives the changes made during a frame, in the order they were applied.
+        /// \note Each change is expressed in coordinates of the document produced by the changes before it.
+        ///       Changes made through other views of the document are reported as well.
+        std::function<void(TextEditor*, const std::vector<TextChange>&)> OnTextChanges;
+        /// \brief Receives the bytes read so far and the file size while LoadFileAsync() runs.
+        std::function<void(TextEditor*, size_t, size_t)> OnLoadProgress;
+        /// \brief Receives the zero-based line found by FindInFileView(), or -1 if the text was not found.
+        std::function<void(TextEditor*, int64_t)> OnFileViewFind;
+        /// \brief Called after the watched file changed on disk and the editor reloaded it.
+        std::function<void(TextEditor*)> OnFileReload;
+        /// \brief Called instead of reloading when the watched file changed on disk while the editor has unsaved edits.
+        /// \note Receives the text of the file, pass it to ReloadText() to take it over.
+        std::function<void(TextEditor*, const std::string&)> OnFileConflict;
+
+        /// \brief Set the path of the file shown in the editor, a running file watch follows it.
+        /// \param aPath File path.
+        void SetPath(const std::string& aPath);
         inline const std::string& GetPath() { return mPath; }
 
+        /// \brief Watch the file set with SetPath() and reload it when it is modified on disk.
+        /// \param aValue True to start watching, false to stop.
+        /// \param aPolling True to poll the modification time instead of using inotify.
+        /// \note Bursts of writes are reloaded once, after the file has been quiet for the watch
+        ///       delay. Reloading uses ReloadText(), so only the changed lines are replaced. Edits
+        ///       made since the file was loaded or saved are never overwritten, OnFileConflict is
+        ///       called instead.
+        void SetFileWatch(bool aValue, bool aPolling = false);
+
+        /// \brief Tell the editor that its text was just written to the watched file.
+        /// \note The file watch then ignores the change caused by the save and keeps the edits made after it.
+        void MarkFileSaved();
+
+        /// \brief Determine if the file is being watched.
+        /// \return True when SetFileWatch() is active.
+        inline bool IsFileWatched() const { return mFileWatch != nullptr; }
+
+        /// \brief Set how long the file has to be quiet before a change is reloaded.
+        /// \param aMilliseconds Delay in milliseconds, applies to the next SetFileWatch().
+        inline void SetFileWatchDelay(int aMilliseconds) { mFileWatchDelay = aMilliseconds; }
+
     private:
+        std::shared_ptr<Document> mDocument;
+        uint64_t mSeenTextVersion;  // document version this view has synced its cursor to
         std::string mPath;
 
         typedef std::vector<std::pair<std::regex, PaletteIndex>> RegexList;
@@ -846,6 +1183,8 @@ namespace ImTextEdit {
 
             EditorState mBefore;
             EditorState mAfter;
+
+            std::vector<UndoRecord> mOperations; ///< Records grouped by BeginEdit()/EndEdit(), replayed as one step.
         };
 
         typedef std::vector<UndoRecord> UndoBuffer;
@@ -860,7 +1199,20 @@ namespace ImTextEdit {
         void Advance(Coordinates& aCoordinates) const;
         void DeleteRange(const Coordinates& aStart, const Coordinates& aEnd);
         int InsertTextAt(Coordinates& aWhere, const char* aValue, bool indent = false);
+        void LoadLines(const std::vector<std::pair<const char*, size_t>>& aLines);
+        static void BuildLine(Line& aLine, int aIndex, const char* aText, size_t aSize, int aTabSize, std::vector<Coordinates>& aFoldBegin, std::vector<Coordinates>& aFoldEnd);
+        std::string AutoIndentText(const Coordinates& aWhere, const char* aValue, std::vector<int>& aIndents) const;
         void AddUndo(UndoRecord& aValue);
+        void InsertTextInternal(const char* aValue, bool indent);
+        void MarkTextChanged();
+        void NotifyContentUpdate();
+        bool WantsTextChanges() const;
+        void AddTextChange(const Coordinates& aStart, const Coordinates& aEnd, const std::string& aText);
+        void QueueTextChange(const Coordinates& aStart, const Coordinates& aEnd, const std::string& aText);
+        void BeginViewRemap();
+        void EndViewRemap();
+        std::array<Coordinates*, 5> GetViewPositions();
+        Coordinates GetTextEnd(const Coordinates& aStart, const std::string& aText) const;
         Coordinates ScreenPosToCoordinates(const ImVec2& aPosition) const;
         Coordinates MousePosToCoordinates(const ImVec2& aPosition) const;
         ImVec2 CoordinatesToScreenPos(const Coordinates& aPosition) const;
@@ -875,6 +1227,18 @@ namespace ImTextEdit {
         void RemoveLine(int aStart, int aEnd);
         void RemoveLine(int aIndex);
         Line& InsertLine(int aIndex, int column);
+
+        /// \brief Change in line count recorded while editing.
+        struct LineShift
+        {
+            int mIndex;
+            int mCount; // > 0: lines inserted before mIndex, < 0: lines removed starting at mIndex
+        };
+        void ShiftLines(int aIndex, int aCount);
+        void InvalidateSnapshotLines(int aFromLine, int aToLine);
+        int RemapLine(int aLine) const;
+        void ApplyLineShifts();
+        int FindBreakpoint(int aLine) const;
         void EnterCharacter(ImWchar aChar, bool aShift);
         void Backspace();
         void DeleteSelection();
@@ -912,11 +1276,21 @@ namespace ImTextEdit {
 #       endif
 
         float mLineSpacing;
-        Lines mLines;
+        Lines& mLines;
         EditorState mState;
-        UndoBuffer mUndoBuffer;
-        int mUndoIndex;
-        int mReplaceIndex;
+        UndoBuffer& mUndoBuffer;
+        int& mUndoIndex;
+
+        int mEditDepth;
+        bool mEditContentChanged;
+        int mEditLineMin, mEditLineMax;
+        UndoRecord mEditUndo;
+        std::vector<LineShift> mLineShifts;
+        std::vector<Coordinates> mEditFoldBegin, mEditFoldEnd;
+        ErrorMarkers mEditErrorMarkers;
+        std::vector<Breakpoint> mEditBreakpoints;
+        std::vector<int> mEditRemovedBreakpoints;
+        std::vector<int> mEditChangedLines;
 
         bool mSidebar;
         bool mHasSearch;
@@ -928,19 +1302,183 @@ namespace ImTextEdit {
         bool mFindFocused, mReplaceFocused;
         bool mReplaceOpened;
         char mReplaceWord[256];
+        bool mFindRegex;
+        bool mFindCaseSensitive;
+
+        /// \brief Match found by the search worker, in byte offsets inside the line.
+        struct SearchMatch
+        {
+            int mLine;
+            int mStart, mEnd;
+        };
+        /// \brief Search running on a detached worker over a snapshot of the document.
+        struct SearchJob
+        {
+            std::string mPattern;
+            std::string mReplace;
+            bool mRegex = false;
+            bool mCaseSensitive = false;
+            bool mReplaceAll = false;
+            bool mInvalid = false;
+            std::regex mExpression;
+            uint64_t mVersion = 0;
+            std::shared_ptr<const DocumentSnapshot> mSnapshot;  // the line texts are built on the worker
+
+            std::atomic<bool> mCancel{ false };
+            std::mutex mMutex;
+            bool mDone = false;                 // guarded by mMutex
+            std::vector<SearchMatch> mPending;  // guarded by mMutex
+            int mReplacedFirst = -1, mReplacedLast = -1;
+            std::string mReplaced;              // replace-all result for lines [mReplacedFirst, mReplacedLast]
+        };
+        enum class SearchAction { None, Find, Replace, ReplaceAll };
+        std::shared_ptr<SearchJob> mSearchJob;
+        std::vector<SearchMatch> mSearchResults;
+        bool mSearchDone;
+        SearchAction mSearchAction;
+        void mStartSearch(bool aReplaceAll);
+        void mCancelSearch();
+        void mUpdateSearch();
+        bool mResolveSearchAction();
+        static void mRunSearch(std::shared_ptr<SearchJob> aJob);
+
+        /// \brief File read by LoadFileAsync() on a detached worker.
+        struct LoadJob
+        {
+            FILE* mFile = nullptr;
+            int mTabSize = 4;
+            size_t mSize = 0;
+
+            std::atomic<bool> mCancel{ false };
+            std::mutex mMutex;
+            bool mDone = false;                 // guarded by mMutex
+            size_t mRead = 0;                   // guarded by mMutex
+            std::vector<Line> mPending;         // guarded by mMutex
+            std::vector<Coordinates> mPendingFoldBegin, mPendingFoldEnd; // guarded by mMutex, relative to mPending
+        };
+        std::shared_ptr<LoadJob> mLoadJob;
+        bool mLoadFirstChunk;
+        void mUpdateLoad();
+        static void mRunLoad(std::shared_ptr<LoadJob> aJob);
+
+        /// \brief Memory-mapped file shown by OpenFileView(), its line index is built by a detached worker.
+        struct FileView
+        {
+            ~FileView();
+
+            const char* mData = nullptr;
+            size_t mSize = 0;
+#ifdef _WIN32
+            void* mFile = nullptr;
+            void* mMapping = nullptr;
+#else
+            int mFile = -1;
+#endif
+
+            std::atomic<bool> mCancel{ false };
+            mutable std::mutex mMutex;
+            std::vector<size_t> mIndex;         // guarded by mMutex, offset of every FileViewIndexStep-th line
+            int64_t mLineCount = 0;             // guarded by mMutex
+            bool mIndexed = false;              // guarded by mMutex
+        };
+        std::shared_ptr<FileView> mFileView;
+        std::list<std::pair<int64_t, Line>> mFileViewCache; // decoded lines, most recently used first
+        std::unordered_map<int64_t, std::list<std::pair<int64_t, Line>>::iterator> mFileViewLines;
+        int64_t mFileViewScrollTo;
+        int64_t mFileViewTopLine;   // scrolled in whole lines, pixel offsets of millions of lines don't fit in a float
+        size_t GetFileViewLineOffset(int64_t aLine) const; // end of the file for a line that is not indexed
+        const Line& GetFileViewLine(int64_t aLine);
+        void RenderFileView(const char* aTitle, const ImVec2& aSize, bool aBorder);
+        static void mIndexFileView(std::shared_ptr<FileView> aView);
+
+        /// \brief FindInFileView() running on a detached worker.
+        struct FileViewSearch
+        {
+            std::shared_ptr<FileView> mView;
+            std::string mText;
+            int64_t mFromLine = 0;
+            size_t mOffset = 0;                 // offset of mFromLine
+
+            std::atomic<bool> mCancel{ false };
+            std::mutex mMutex;
+            bool mDone = false;                 // guarded by mMutex
+            int64_t mLine = -1;                 // guarded by mMutex
+        };
+        std::shared_ptr<FileViewSearch> mFileViewSearch;
+        void mUpdateFileViewSearch();
+        static void mRunFileViewSearch(std::shared_ptr<FileViewSearch> aJob);
+
+        /// \brief File watched on a detached worker, which reads it once the changes settle.
+        struct FileWatch
+        {
+            std::string mPath;
+            bool mPolling = false;
+            int mDelay = 0;
+
+            std::atomic<bool> mCancel{ false };
+            std::mutex mMutex;
+            bool mPending = false;  // guarded by mMutex
+            std::string mText;      // guarded by mMutex
+        };
+        std::shared_ptr<FileWatch> mFileWatch;
+        int mFileWatchDelay;
+        uint64_t mFileVersion;      // text version known to match the file on disk
+        uint64_t mFileSavedHash;    // hash of the text written by the last save, valid if mFileSaved
+        bool mFileSaved;
+        uint64_t HashText() const;
+        void mUpdateFileWatch();
+        static void mRunFileWatch(std::shared_ptr<FileWatch> aWatch);
 
         bool mFoldEnabled;
-        std::vector<Coordinates> mFoldBegin, mFoldEnd;
-        std::vector<int> mFoldConnection;
-        std::vector<bool> mFold;
-        bool mFoldSorted;
+        std::vector<Coordinates>& mFoldBegin;
+        std::vector<Coordinates>& mFoldEnd;
+        std::vector<int>& mFoldConnection;
+        std::vector<bool>& mFold;
+        bool& mFoldSorted;
         void mRemoveFolds(const Coordinates& start, const Coordinates& end);
         void mRemoveFolds(std::vector<Coordinates>& folds, const Coordinates& start, const Coordinates& end);
         uint64_t mFoldLastIteration;
         float mLastScroll;
 
-        std::vector<std::string> mACEntrySearch;
-        std::vector<std::pair<std::string, std::string>> mACEntries;
+        /// \brief Autocomplete candidate with its lookup key prepared once.
+        struct ACCandidate
+        {
+            std::string mKey;       // lowercase search string
+            uint64_t mMask;         // characters present in mKey, rejects most candidates before scoring
+            std::string mDisplay;
+            std::string mValue;
+            bool mCall;             // functions get "()" appended when braces are completed
+            bool mCustom;           // added with AddAutocompleteEntry()
+        };
+        std::vector<ACCandidate> mACCandidates;
+        bool mACCandidatesDirty;    // language or parser data changed, rebuilt on the next lookup
+        static ACCandidate mMakeACCandidate(const std::string& aSearch, const std::string& aDisplay, const std::string& aValue, bool aCall, bool aCustom);
+        void mBuildACCandidates();
+
+        // identifiers of the document offered as completions, maintained by ColorizeRange()
+        void SetLineWords(int aLine, const std::vector<std::string>& aWords);
+        void ReleaseLineWords(int aFrom, int aTo);
+        void ResizeLineWords(int aCount);
+
+        /// \brief Autocomplete request waiting for its delay or running on the provider.
+        struct ACProviderJob
+        {
+            AutocompleteRequest mRequest;
+            std::shared_ptr<std::atomic<bool>> mCancel;
+            std::chrono::steady_clock::time_point mTime;
+            bool mDispatched = false;
+
+            std::mutex mMutex;
+            bool mDone = false;                                         // guarded by mMutex
+            std::vector<std::pair<std::string, std::string>> mResults;  // guarded by mMutex
+        };
+        AutocompleteProvider mACProvider;
+        std::function<void(std::function<void()>)> mACExecutor;
+        int mACProviderDelay;
+        std::shared_ptr<ACProviderJob> mACProviderJob;
+        void mRequestACProvider();
+        void mUpdateACProvider();
+        void mCancelACProvider();
 
         bool mIsSnippet;
         std::vector<Coordinates> mSnippetTagStart, mSnippetTagEnd;
@@ -971,8 +1509,30 @@ namespace ImTextEdit {
 
         std::vector<Shortcut> m_shortcuts;
 
+        /// \brief Result of GetRelevantExpressions() for one line.
+        struct ExpressionCache
+        {
+            uint64_t mTextVersion;
+            uint64_t mColorVersion;
+            std::string mText;      // line text with comments blanked out
+            std::vector<std::string> mExpressions;
+        };
+        std::unordered_map<int, ExpressionCache> mExpressionCache;
+
+        bool mRecordingInput;
+        InputRecording mInputRecording;
+        void RecordInputFrame();
+
+        // shortcuts by (Key1, modifiers) so that each bound key is polled once per frame
+        std::unordered_map<uint64_t, std::vector<ShortcutID>> mShortcutTable;
+        std::vector<int> mShortcutKeys;     // distinct Key1 values
+        bool mShortcutTableDirty;
+        void BuildShortcutTable();
+        std::vector<ShortcutID> GetPressedShortcuts();
+        bool IsShortcutPressed(ShortcutID aID) const;
+
         bool mScrollbarMarkers;
-        std::vector<int> mChangedLines;
+        std::vector<int>& mChangedLines;
 
         std::vector<int> mHighlightedLines;
 
@@ -991,11 +1551,19 @@ namespace ImTextEdit {
         bool mScrollToCursor;
         bool mScrollToTop;
         bool mTextChanged;
+        uint64_t& mTextVersion;
+        std::vector<TextChange> mTextChanges;
+        bool mViewRemapPending;                     // another view is editing, mViewRemap holds the positions below
+        std::array<Coordinates, 5> mViewRemap;      // cursor, selection and interactive range in glyph indices
+        std::vector<uint64_t>& mLineOffsets;    // byte offset of every line start, rebuilt when the version changes
+        uint64_t& mLineOffsetsVersion;
+        void UpdateLineOffsets() const;
         bool mColorizerEnabled;
         float mTextStart;                   // position (in pixels) where a code line starts relative to the left of the TextEditor.
         int  mLeftMargin;
         bool mCursorPositionChanged;
-        int mColorRangeMin, mColorRangeMax;
+        int& mColorRangeMin;
+        int& mColorRangeMax;
         SelectionMode mSelectionMode;
         bool mHandleKeyboardInputs;
         bool mHandleMouseInputs;
@@ -1015,26 +1583,116 @@ namespace ImTextEdit {
         int mDebugCurrentLine;
         ImVec2 mUICursorPos, mFindOrigin;
         float mWindowWidth;
-        std::vector<Breakpoint> mBreakpoints;
+        std::vector<Breakpoint>& mBreakpoints;
         ImVec2 mRightClickPos;
 
         int mPopupCondition_Line;
         bool mPopupCondition_Use;
         char mPopupCondition_Condition[512];
 
-        bool mCheckComments;
-        ErrorMarkers mErrorMarkers;
+        bool& mCheckComments;
+
+        /// \brief State of the comment scan at the start of a line.
+        struct CommentScanState
+        {
+            bool mInBlockComment = false;
+            bool mInString = false;
+            bool mInLineComment = false;
+            bool mInPreproc = false;
+            bool mFirstChar = true;
+            bool mConcatenate = false;
+        };
+        int& mCommentScanFrom;                  // first line of the pending comment scan
+        int& mTailCommentLine;                  // last line reached by the previous scan, -1 when unknown
+        CommentScanState& mTailCommentState;    // scan state at the start of mTailCommentLine
+        int mMaxLineCount;
+        bool mAutoScroll;
+        bool mPinnedToBottom;
+        bool mScrollToBottom;
+        void DropFrontLines(int aCount);
+        ErrorMarkers& mErrorMarkers;
         ImVec2 mCharAdvance;
         Coordinates mInteractiveStart, mInteractiveEnd;
         std::string mLineBuffer;
         uint64_t mStartTime;
 
-        Coordinates mLastHoverPosition;
-        std::chrono::steady_clock::time_point mLastHoverTime;
+        /// \brief Hover target, resolved once per mouse position, text version and debugger step.
+        struct HoverCache
+        {
+            ImVec2 mMousePos = ImVec2(-FLT_MAX, -FLT_MAX);
+            ImVec2 mOrigin;
+            ImVec2 mCharAdvance;
+            uint64_t mTextVersion = 0;
+            int mDebugLine = 0;
+            Coordinates mPosition;          // MousePosToCoordinates()
+            Coordinates mWordPosition;      // ScreenPosToCoordinates()
+            std::chrono::steady_clock::time_point mTime;
+
+            bool mExpressionResolved = false;
+            std::string mExpression;
+            int mExpressionHover = -1;      // HasExpressionHover() result, -1 until asked
+            bool mWordResolved = false;
+            std::string mWord;
+            int mIdentifierHover = -1;      // HasIdentifierHover() result, -1 until asked
+        };
+        HoverCache mHover;
+        std::string GetHoverExpression(const Coordinates& aPosition, Char aHoverChar) const;
 
         float mLastClick;
     };
 
+    /// \brief Text shared by one or more TextEditor views.
+    /// \note Holds the lines, colors, folds, markers and undo history. Cursor, selection and scroll
+    ///       stay in each view.
+    class TextEditor::Document
+    {
+    public:
+        Document();
+
+    private:
+        friend class TextEditor;
+
+        Lines mLines;
+        UndoBuffer mUndoBuffer;
+        int mUndoIndex;
+        uint64_t mTextVersion;
+        std::vector<uint64_t> mLineOffsets;
+        uint64_t mLineOffsetsVersion;
+
+        std::vector<Coordinates> mFoldBegin, mFoldEnd;
+        std::vector<int> mFoldConnection;
+        std::vector<bool> mFold;
+        bool mFoldSorted;
+
+        ErrorMarkers mErrorMarkers;
+        std::vector<Breakpoint> mBreakpoints;
+        std::vector<int> mChangedLines;
+
+        int mColorRangeMin, mColorRangeMax;
+        bool mCheckComments;
+        int mCommentScanFrom;
+        int mTailCommentLine;
+        CommentScanState mTailCommentState;
+        uint64_t mColorVersion;             // incremented whenever glyph colors change
+
+        std::vector<std::shared_ptr<const Line>> mSnapshotLines;   // line copies shared with the snapshots, nullptr once the line changed
+        std::shared_ptr<const DocumentSnapshot> mSnapshot;
+        bool mSnapshotStale;                // a line changed since mSnapshot was taken
+
+        std::vector<TextEditor*> mViews;    // views to remap when lines are inserted or removed
+
+        struct BufferWord
+        {
+            ACCandidate mCandidate;
+            int mRefs;                      // lines containing the word, 0 marks a free slot
+        };
+        std::vector<std::vector<int>> mLineWords;           // sorted word ids of each colorized line
+        std::vector<BufferWord> mWords;
+        std::unordered_map<std::string, int> mWordIds;
+        std::vector<int> mFreeWords;
+    };
+    typedef TextEditor::Document TextDocument;
+
     /// \brief Retrieve default keyboard shortcuts.
     const std::vector<Shortcut> GetDefaultShortcuts();
     /// \brief Get built-in dark color palette.